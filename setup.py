@@ -24,6 +24,9 @@ ext_modules = [
          "src/core/dsmga2.cpp",
          "src/core/fastcounting.cpp",
          "src/core/global.cpp",
+         "src/core/maskgrower.cpp",
+         "src/core/localsearch.cpp",
+         "src/utils/bitkernels.cpp",
          "src/utils/mt19937ar.cpp",
          "src/utils/myrand.cpp",
          "src/functions/spin.cpp",
@@ -9,14 +9,30 @@
 #include "global.h"
 #include "nk-wa.h"
 #include <functional>
+#include <vector>
 
 using namespace std;
 
+struct GeneKernels;
+
 class Chromosome {
 
 public:
 
     static std::function<double(const Chromosome&)> customFunction;
+
+    // fills fitness[k] with the fitness of *chs[k] for k in [0, n)
+    typedef std::function<void(const Chromosome* const* chs, int n, double* fitness)> BatchFunction;
+    static BatchFunction batchFunction;     // optional; customFunction one at a time otherwise
+    static bool batchPreferred;             // batches pay off even on one thread, e.g. one Python call each
+
+    // fitness change if the given bits of ch flipped
+    typedef std::function<double(const Chromosome& ch, const int* bits, int n)> DeltaFunction;
+    static DeltaFunction deltaFunction;     // optional; used with DELTA_EVAL
+
+    // appends the variables sharing a subfunction with i
+    typedef std::function<void(int length, int i, std::vector<int>& out)> NeighbourFunction;
+    static NeighbourFunction neighbourFunction;     // optional; for local search
     static enum Function {
         ONEMAX=0,
         MKTRAP=1,
@@ -31,6 +47,8 @@ public:
 
     Chromosome ();
     Chromosome (int n_ell);
+    Chromosome (const Chromosome& c);
+    Chromosome (Chromosome&& c) noexcept;
 
     ~Chromosome ();
 
@@ -55,20 +73,63 @@ public:
 
     void flip (int index);
 
+    bool copyMasked (const Chromosome& c, const unsigned long* mask);
+
+    bool agreesWith (const Chromosome& c, const unsigned long* mask) const;
+
     int getLength () const;
 
+    int getLengthLong () const;
+
+    const unsigned long* getGene () const;
+
     void setLength ();
 
     double getMaxFitness () const;
 
+    double computeFitness () const;
+
+    static void computeFitness (const Chromosome* const* chs, int n, double* fitness);
+
     double evaluate ();
 
     bool isEvaluated () const;
 
     double getFitness ();
 
+    // getFitness() for a value computeFitness() already returned; not
+    // counted in nfe when the evaluations it stands for already were
+    double recordFitness (double f, bool counted = true);
+
+    // getFitness() for every chromosome, in order, with one batch
+    static void evaluateBatch (Chromosome* const* chs, int n);
+
+    // whether the fitness after some flips can come from deltaFunction
+    bool canDelta () const;
+
+    // fitness after flipping the bits, from the current one; needs canDelta()
+    double deltaFitness (const int* bits, int n) const;
+
+    // fitness after copyMasked(c, mask); needs canDelta()
+    double deltaFitness (const Chromosome& c, const unsigned long* mask) const;
+
+    // whether a trial whose deltaFitness() is f is below this chromosome
+    // by more than the accept tests' EPSILON and the rounding of deltas,
+    // so that every test rejects it whatever the full evaluation says;
+    // needs canDelta()
+    bool surelyWorse (double f) const;
+
     bool operator== (const Chromosome & c) const;
     Chromosome & operator= (const Chromosome & c);
+    Chromosome & operator= (Chromosome && c) noexcept;
+
+    // exchanges genes, key and fitness; heap genes trade pointers
+    void swap (Chromosome& c) noexcept;
+
+    // use words (lengthLong of them) as the gene, e.g. a GeneArena row;
+    // the chromosome does not own them. Copies are never views.
+    void attach (unsigned long* words, int _length);
+    bool isView () const;
 
 public:
     static int nfe;
@@ -79,12 +140,25 @@ public:
 
 protected:
 
+    // genes of up to INLINE_WORDS words are kept in the object itself;
+    // population members are GeneArena views, so it only serves scratch
+    // and stand-alone chromosomes and is kept small. lengthLong is
+    // ell / 64 + 1, one word more than the bits need when ell is a
+    // multiple of 64, so 2 words would stop short of ell = 128.
+    enum { INLINE_WORDS = 3 };      // genes of up to 191 bits stay inline
+
+    void allocate (int words);
+    void release ();
+
     unsigned long *gene;
+    unsigned long inlineGene[INLINE_WORDS];
+    const GeneKernels* kernels;     // word loops for lengthLong
     int length;
     int lengthLong;
     double fitness;
-    bool evaluated;
     unsigned long key;
+    bool evaluated;
+    bool view;                      // gene is someone else's row
 
 };
 
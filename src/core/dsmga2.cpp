@@ -6,27 +6,42 @@
 #include <list>
 #include <vector>
 #include <algorithm>
+#include <cstring>
 #include <iterator>
+#include <mutex>
 
 #include <iostream>
 #include "chromosome.h"
 #include "dsmga2.h"
 #include "fastcounting.h"
 #include "statistics.h"
+#include "bitkernels.h"
+#include "localsearch.h"
 
 #include <iomanip>
+#include <functional>
 using namespace std;
 
 
-DSMGA2::DSMGA2 (int n_ell, int n_nInitial, int n_maxGen, int n_maxFe, std::function<double(const Chromosome&)> customFn) {
+DSMGA2::DSMGA2 (int n_ell, int n_nInitial, int n_maxGen, int n_maxFe, std::function<double(const Chromosome&)> customFn,
+                Chromosome::BatchFunction batchFn, Chromosome::DeltaFunction deltaFn,
+                Chromosome::NeighbourFunction neighbourFn) {
 
 
     previousFitnessMean = -INF;
     ell = n_ell;
     nCurrent = (n_nInitial/2)*2;  // has to be even
 
+    if (ZOBRIST_FILE != NULL)
+        zKey.load(ZOBRIST_FILE, ell);
+    else
+        zKey.init(ell, ZOBRIST_SEED);
+
     Chromosome::function = Chromosome::CUSTOM;
     Chromosome::customFunction = customFn;
+    Chromosome::batchFunction = batchFn;
+    Chromosome::deltaFunction = deltaFn;
+    Chromosome::neighbourFunction = neighbourFn;
     Chromosome::nfe = 0;
     Chromosome::lsnfe = 0;
     Chromosome::hitnfe = 0;
@@ -36,8 +51,20 @@ DSMGA2::DSMGA2 (int n_ell, int n_nInitial, int n_maxGen, int n_maxFe, std::funct
     maxGen = n_maxGen;
     maxFe = n_maxFe;
 
-    graph.init(ell);
-    graph_size.init(ell);
+    if (SPARSE_K == 0) {
+        if (ROW_LINKAGE)
+            rowGraph.init(ell, HUGE_PAGES);
+        else
+            graph.init(ell, HUGE_PAGES);
+    }
+    sizeGraphShared = true;
+    nSample = nCurrent;
+
+    pool = (THREADS > 1) ? new ThreadPool(THREADS) : NULL;
+    popWords = 0;
+    trialScratch.init(ell);
+    skippedTrials = 0;
+    countsValid = false;
      
     bestIndex = -1;
     masks = new list<int>[ell];
@@ -51,16 +78,25 @@ DSMGA2::DSMGA2 (int n_ell, int n_nInitial, int n_maxGen, int n_maxFe, std::funct
         fastCounting[i].init(nCurrent);
 
 
+    popArena.init(nCurrent, quotientLong(ell) + 1);
+
     pHash.clear();
     for (int i=0; i<nCurrent; ++i) {
+        population[i].attach(popArena.row(i), ell);
         population[i].initR(ell);
         double f = population[i].getFitness();
         pHash[population[i].getKey()] = f;
     }
 
     if (GHC) {
-        for (int i=0; i < nCurrent; i++)
-            population[i].GHC();
+        if (STEEPEST_GHC) {
+            for (int i=0; i < nCurrent; i++)
+                population[i].steepestDescent();
+        } else if (LocalSearch::available()) {
+            for (int i=0; i < nCurrent; i++)
+                population[i].GHC();
+        } else
+            batchGHC();
     }
 }
 
@@ -72,6 +108,7 @@ DSMGA2::~DSMGA2 () {
     delete []selectionIndex;
     delete []population;
     delete []fastCounting;
+    delete pool;
 }
 
 
@@ -183,23 +220,110 @@ void DSMGA2::showStatistics () {
 
 
 
+// whether the columns come from a fresh random subset every generation
+bool DSMGA2::sampling() const {
+    return SAMPLE_SIZE > 0 && SAMPLE_SIZE < nCurrent;
+}
+
 void DSMGA2::buildFastCounting() {
 
-    if (SELECTION) {
-        for (int i = 0; i < nCurrent; i++)
-            for (int j = 0; j < ell; j++) {
-                fastCounting[j].setVal(i, population[selectionIndex[i]].getVal(j));
-            }
+    if (sampling()) {
+        sampleFastCounting();
+        return;
+    }
 
-    } else {
-        for (int i = 0; i < nCurrent; i++)
-            for (int j = 0; j < ell; j++) {
-                fastCounting[j].setVal(i, population[i].getVal(j));
-            }
+    nSample = nCurrent;
+
+    vector<const unsigned long*> rows(nCurrent);
+    for (int k = 0; k < nCurrent; k++)
+        rows[k] = selected(k).getGene();
+    transposeColumns(rows);
+
+}
+
+void DSMGA2::transposeColumns(const vector<const unsigned long*>& rows) {
+
+    vector<unsigned long*> cols(ell);
+    for (int j = 0; j < ell; j++)
+        cols[j] = fastCounting[j].gene;
+    transposeBits(&rows[0], (int) rows.size(), ell, &cols[0]);
+}
+
+// Fills fastCounting from a random subset of the selected rows. With
+// SAMPLE_GROW the subset starts at SAMPLE_SIZE rows and is doubled until
+// the linkage of a few random probe pairs moves by less than
+// SAMPLE_TOLERANCE, or the whole population is in.
+void DSMGA2::sampleFastCounting() {
+
+    vector<int> slot(nCurrent);
+    myRand.uniformArray(&slot[0], nCurrent, 0, nCurrent - 1);
+
+    for (int j = 0; j < ell; j++)
+        memset(fastCounting[j].gene, 0, sizeof(unsigned long) * fastCounting[j].lengthLong);
+
+    countLog.init(nCurrent);
+    nSample = 0;
+    addSampleRows(slot, min(SAMPLE_SIZE, nCurrent));
+    if (!SAMPLE_GROW || ell < 2)
+        return;
+
+    const int nProbes = 64;
+    vector<pair<int, int> > probe(nProbes);
+    for (int p = 0; p < nProbes; ++p) {
+        int i = myRand.uniformInt(0, ell - 1);
+        int j = myRand.uniformInt(0, ell - 2);
+        if (j >= i) ++j;
+        probe[p] = make_pair(min(i, j), max(i, j));
     }
 
+    vector<pair<double, double> > last(nProbes);
+    probeLinkage(probe, last);
+
+    vector<pair<double, double> > now(nProbes);
+    while (nSample < nCurrent) {
+        addSampleRows(slot, min(2 * nSample, nCurrent));
+        probeLinkage(probe, now);
+
+        double change = 0.0;
+        for (int p = 0; p < nProbes; ++p) {
+            change = max(change, fabs(now[p].first - last[p].first));
+            change = max(change, fabs(now[p].second - last[p].second));
+        }
+        if (change < SAMPLE_TOLERANCE)
+            break;
+        last.swap(now);
+    }
+}
+
+// fills the columns from rows slot[0 .. n)
+void DSMGA2::addSampleRows(const vector<int>& slot, int n) {
+
+    vector<const unsigned long*> rows(n);
+    for (int k = 0; k < n; k++)
+        rows[k] = selected(slot[k]).getGene();
+    transposeColumns(rows);
+    nSample = n;
 }
 
+POPCNT_CLONES
+void DSMGA2::probeLinkage(const vector<pair<int, int> >& probe, vector<pair<double, double> >& result) const {
+
+    const int nWords = quotientLong(nSample) + 1;
+
+    for (size_t p = 0; p < probe.size(); ++p) {
+        const unsigned long* a = fastCounting[probe[p].first].gene;
+        const unsigned long* b = fastCounting[probe[p].second].gene;
+        int oneA = 0, oneB = 0, n11 = 0;
+        for (int w = 0; w < nWords; ++w) {
+            oneA += myBD.countOne(a[w]);
+            oneB += myBD.countOne(b[w]);
+            n11 += myBD.countOne(a[w] & b[w]);
+        }
+        result[p] = twoEdgeLinkage(oneA, oneB, n11);
+    }
+}
+
+POPCNT_CLONES
 int DSMGA2::countOne(int x) const {
 
     int n = 0;
@@ -216,6 +340,7 @@ int DSMGA2::countOne(int x) const {
 }
 
 
+POPCNT_CLONES
 int DSMGA2::countXOR(int x, int y) const {
 
     int n = 0;
@@ -240,55 +365,25 @@ int DSMGA2::countXOR(int x, int y) const {
 void DSMGA2::findMask(Chromosome& ch, list<int>& result,int startNode){
     result.clear();
 
-    
-	DLLA rest(ell);
 	genOrderELL();
-	for( int i = 0; i < ell; i++){
-		if(orderELL[i] == startNode)
-			result.push_back(orderELL[i]);
-		else
-			rest.insert(orderELL[i]);
-	}
-
-	double *connection = new double[ell];
+	startMask(ch, startNode, false);
 
-	for(DLLA::iterator iter = rest.begin(); iter != rest.end(); iter++){
-	    pair<double, double> p = graph(startNode, *iter);
-		int i = ch.getVal(startNode);
-		int j = ch.getVal(*iter);
-		if(i == j)//p00 or p11
-			connection[*iter] = p.first;
-		else      //p01 or p10
-			connection[*iter] = p.second;
-	}
-   
-    while(!rest.isEmpty()){
-
-	    double max = -INF;
-		int index = -1;
-		for(DLLA::iterator iter = rest.begin(); iter != rest.end(); iter++){
-		    if(max < connection[*iter]){
-			    max = connection[*iter];
-				index = *iter;
-			}
-		}
-
-		rest.erase(index);
-		result.push_back(index);
-
-		for(DLLA::iterator iter = rest.begin(); iter != rest.end(); iter++){
-			pair<double, double> p = graph(index, *iter);
-			int i = ch.getVal(index);
-			int j = ch.getVal(*iter);
-			if(i == j)//p00 or p11
-				connection[*iter] += p.first;
-			else      //p01 or p10
-				connection[*iter] += p.second;
-		}
-	}
+	for (int node = maskGrower.next(); node >= 0; node = maskGrower.next())
+		result.push_back(node);
+}
 
-	delete []connection;
-  
+// Starts growing the mask of ch from startNode on graph (or on graph_size
+// if sizeGraph); the variables are pulled from maskGrower.next().
+void DSMGA2::startMask(Chromosome& ch, int startNode, bool sizeGraph) {
+
+	if (SPARSE_K > 0)
+		maskGrower.start(sparseGraph, ch, orderELL, ell, startNode);
+	else if (ROW_LINKAGE)
+		maskGrower.start((sizeGraph && !sizeGraphShared) ? rowGraph_size : rowGraph, ch, orderELL, ell, startNode);
+	else if (sizeGraph && !sizeGraphShared)
+		maskGrower.start(graph_size, ch, orderELL, ell, startNode);
+	else
+		maskGrower.start(graph, ch, orderELL, ell, startNode);
 }
 
 void DSMGA2::restrictedMixing(Chromosome& ch) {
@@ -297,13 +392,13 @@ void DSMGA2::restrictedMixing(Chromosome& ch) {
     
 
 
+    // masks are only grown as far as findSize looks
     list<int> mask;
-	findMask(ch, mask,startNode);
-    size_t size = findSize(ch, mask);
+	genOrderELL();
+    size_t size = findMaskAndSize(ch, startNode, false, ell, mask);
    
     list<int> mask_size; 
-    findMask_size(ch,mask_size,startNode,size);
-    size_t size_original = findSize(ch,mask_size);
+    size_t size_original = findMaskAndSize(ch, startNode, true, size, mask_size);
 
     if (size > size_original)
         size = size_original;
@@ -315,9 +410,20 @@ void DSMGA2::restrictedMixing(Chromosome& ch) {
 
     EQ = true;
     if (taken) {
+
+        packMask(mask);
     
         genOrderN();
 
+        // one batch of trials only pays off spread over the pool or for an
+        // objective that is cheaper called once per batch; otherwise the
+        // trials are made in place, one at a time
+        if ((PARALLEL_BACKMIXING && pool != NULL) ||
+            (Chromosome::batchPreferred && Chromosome::batchFunction != nullptr)) {
+            batchBackMixing(ch, mask);
+            return;
+        }
+
         for (int i=0; i<nCurrent; ++i) {
 
             if (EQ)
@@ -328,90 +434,168 @@ void DSMGA2::restrictedMixing(Chromosome& ch) {
     }
 
 }
+// startMask + findSize, with the mask remembered for the rest of the
+// generation. The graph does not change within a generation, so the mask
+// only depends on startNode and ch, unless the growth hit a tie, which
+// orderELL breaks. The size depends on the population as well and is
+// counted again along the remembered mask; only when that needs more of
+// the mask than was grown is it grown again.
+size_t DSMGA2::findMaskAndSize(Chromosome& ch, int startNode, bool sizeGraph, int bound, list<int>& mask) {
+
+    if (!MASK_CACHE || SPARSE_K > 0) {
+        startMask(ch, startNode, sizeGraph);
+        return findSize(ch, mask, bound);
+    }
+
+    unordered_map<unsigned long, MaskCacheEntry>& cache = maskCache[sizeGraph ? 1 : 0];
+    unsigned long key = ch.getKey() ^ zKey[startNode];
+    unordered_map<unsigned long, MaskCacheEntry>::iterator it = cache.find(key);
+    if (it != cache.end() && it->second.startNode == startNode && it->second.chKey == ch.getKey()) {
+        size_t size;
+        if (replaySize(ch, it->second.mask, bound, mask, size))
+            return size;
+        mask.clear();
+    }
+
+    startMask(ch, startNode, sizeGraph);
+    size_t size = findSize(ch, mask, bound);
+
+    if (!maskGrower.tied()) {
+        MaskCacheEntry& e = (it != cache.end()) ? it->second : cache[key];
+        if (e.mask.size() < mask.size() || e.chKey != ch.getKey() || e.startNode != startNode) {
+            e.startNode = startNode;
+            e.chKey = ch.getKey();
+            e.mask.assign(mask.begin(), mask.end());
+        }
+    }
+
+    return size;
+}
+
+// findSize along a mask grown before. Returns false if the size needs
+// more of the mask than was grown.
+bool DSMGA2::replaySize(Chromosome& ch, const vector<int>& grown, int bound, list<int>& mask, size_t& size) {
+
+    resetCandidates();
+
+    size = 0;
+    for (size_t t = 0; (int) mask.size() < bound; ++t) {
+
+        if (t == grown.size())
+            return (int) grown.size() == ell;
+
+        int node = grown[t];
+        mask.push_back(node);
+
+        if (!dropAgreeing(ch, node))
+            break;
+
+        ++size;
+    }
+
+    return true;
+}
+
+void DSMGA2::clearMaskCache() {
+    maskCache[0].clear();
+    maskCache[1].clear();
+}
+
 void DSMGA2::findMask_size(Chromosome& ch, list<int>& result,int startNode,int bound){
     result.clear();
 
-    
-	DLLA rest(ell);
+	startMask(ch, startNode, true);
 
-	for( int i = 0; i < ell; i++){
-		if(orderELL[i] == startNode)
-			result.push_back(orderELL[i]);
-		else
-			rest.insert(orderELL[i]);
+	for (int node = maskGrower.next(); node >= 0; node = maskGrower.next()) {
+		result.push_back(node);
+		if ((int) result.size() >= bound)
+			break;
 	}
+}
 
-	double *connection = new double[ell];
-
-	for(DLLA::iterator iter = rest.begin(); iter != rest.end(); iter++){
-	    pair<double, double> p = graph_size(startNode, *iter);
-		int i = ch.getVal(startNode);
-		int j = ch.getVal(*iter);
-		if(i == j)//p00 or p11
-			connection[*iter] = p.first;
-		else      //p01 or p10
-			connection[*iter] = p.second;
-	}
-    bound--;
-    while(!rest.isEmpty()&&bound>0){
-        bound--;
-	    double max = -INF;
-		int index = -1;
-		for(DLLA::iterator iter = rest.begin(); iter != rest.end(); iter++){
-		    if(max < connection[*iter]){
-			    max = connection[*iter];
-				index = *iter;
-			}
-		}
-
-		rest.erase(index);
-		result.push_back(index);
-
-		for(DLLA::iterator iter = rest.begin(); iter != rest.end(); iter++){
-			pair<double, double> p = graph_size(index, *iter);
-			int i = ch.getVal(index);
-			int j = ch.getVal(*iter);
-			if(i == j)//p00 or p11
-				connection[*iter] += p.first;
-			else      //p01 or p10
-				connection[*iter] += p.second;
-		}
-	}
+// maskWords = mask as one bit per variable, for backMixing(E)
+void DSMGA2::packMask(const list<int>& mask) {
 
-    delete []connection;
-  
+    maskWords.assign(population[0].getLengthLong(), 0ul);
+    for (list<int>::const_iterator it = mask.begin(); it != mask.end(); ++it)
+        maskWords[quotientLong(*it)] |= 1ul << remainderLong(*it);
 }
 
 void DSMGA2::backMixing(Chromosome& source, list<int>& mask, Chromosome& des) {
 
-    Chromosome trial(ell);
+    // nothing would change
+    if (des.agreesWith(source, &maskWords[0])) {
+        skipBackMixing(des);
+        return;
+    }
+
+    Chromosome& trial = trialScratch;
+    double fitness;
+    if (makeTrial(trial, source, des, fitness))
+        trial.recordFitness(fitness);
+    acceptBackMixing(trial, mask, des);
+}
+
+void DSMGA2::backMixingE(Chromosome& source, list<int>& mask, Chromosome& des) {
+
+    // nothing would change; the identical trial would be accepted as equal,
+    // which only puts des back into pHash (a duplicate of des may have been
+    // replaced and taken its key out)
+    if (des.agreesWith(source, &maskWords[0])) {
+        skipBackMixing(des);
+        return;
+    }
+
+    Chromosome& trial = trialScratch;
+    double fitness;
+    if (makeTrial(trial, source, des, fitness))
+        trial.recordFitness(fitness);
+    acceptBackMixingE(trial, mask, des);
+}
+
+// trial = des with the masked variables of source. Returns whether the
+// trial's fitness came from a delta, in which case it is left in fitness
+// for the caller to record; only a trial surely worse than des is
+// settled that way.
+bool DSMGA2::makeTrial(Chromosome& trial, const Chromosome& source, const Chromosome& des, double& fitness) const {
+    bool delta = des.canDelta();
+    if (delta) {
+        fitness = des.deltaFitness(source, &maskWords[0]);
+        delta = des.surelyWorse(fitness);
+    }
     trial = des;
-    for (list<int>::iterator it = mask.begin(); it != mask.end(); ++it)
-        trial.setVal(*it, source.getVal(*it));
+    trial.copyMasked(source, &maskWords[0]);
+    return delta;
+}
+
+void DSMGA2::skipBackMixing(Chromosome& des) {
+    ++skippedTrials;
+    if (EQ)
+        pHash[des.getKey()] = des.getFitness();
+}
+
+void DSMGA2::acceptBackMixing(Chromosome& trial, list<int>& mask, Chromosome& des) {
 
     if (trial.getFitness() > des.getFitness()) {
         pHash.erase(des.getKey());
         pHash[trial.getKey()] = trial.getFitness();
-        des = trial;
+        des.swap(trial);
+        populationChanged(des, mask);
           
         return;
     }
 
 }
 
-void DSMGA2::backMixingE(Chromosome& source, list<int>& mask, Chromosome& des) {
-
-    Chromosome trial(ell);
-    trial = des;
-    for (list<int>::iterator it = mask.begin(); it != mask.end(); ++it)
-        trial.setVal(*it, source.getVal(*it));
+void DSMGA2::acceptBackMixingE(Chromosome& trial, list<int>& mask, Chromosome& des) {
 
     if (trial.getFitness() > des.getFitness()) {
         pHash.erase(des.getKey());
         pHash[trial.getKey()] = trial.getFitness();
 
         EQ = false;
-        des = trial;
+        des.swap(trial);
+        populationChanged(des, mask);
 
 return;
     }
@@ -421,47 +605,182 @@ return;
         pHash.erase(des.getKey());
         pHash[trial.getKey()] = trial.getFitness();
 
-        des = trial;
+        des.swap(trial);
+        populationChanged(des, mask);
         return;
     }
 
 }
 
-bool DSMGA2::restrictedMixing(Chromosome& ch, list<int>& mask) {
+// Every receiver's trial only depends on the receiver itself and the
+// source, so all of them are built first and evaluated as one batch, on
+// the pool with PARALLEL_BACKMIXING. The replacements are then made in
+// orderN order with the fitness already computed, exactly as the serial
+// loop would make them.
+void DSMGA2::batchBackMixing(Chromosome& source, list<int>& mask) {
 
-    bool taken = false;
-    size_t lastUB = 0;
+    bool parallel = PARALLEL_BACKMIXING && pool != NULL;
 
-    for (size_t ub = 1; ub <= mask.size(); ++ub) {
+    if ((int) backTrials.size() < nCurrent) {
+        backTrials.resize(nCurrent);
+        for (int i = 0; i < nCurrent; ++i)
+            backTrials[i].init(ell);
+    }
+    backState.assign(nCurrent, BACK_EVALUATE);
+    backFitness.resize(nCurrent);
+
+    auto buildTrial = [&](int i, int) {
+        const Chromosome& des = population[orderN[i]];
+        if (des.agreesWith(source, &maskWords[0])) {
+            backState[i] = BACK_SKIP;
+            return;
+        }
+        if (makeTrial(backTrials[i], source, des, backFitness[i]))
+            backState[i] = BACK_DELTA;
+    };
+    if (parallel)
+        pool->run(nCurrent, buildTrial);
+    else
+        for (int i = 0; i < nCurrent; ++i)
+            buildTrial(i, 0);
+
+    backBatch.clear();
+    backReceiver.clear();
+    for (int i = 0; i < nCurrent; ++i)
+        if (backState[i] == BACK_EVALUATE) {
+            backBatch.push_back(&backTrials[i]);
+            backReceiver.push_back(i);
+        }
+    int n = (int) backBatch.size();
+    backBatchFitness.resize(n);
+
+    if (parallel) {
+        int nChunks = min(n, 4 * pool->size());
+        pool->run(nChunks, [&](int c, int) {
+            int begin = (int) ((long) n * c / nChunks);
+            int end = (int) ((long) n * (c + 1) / nChunks);
+            Chromosome::computeFitness(&backBatch[begin], end - begin, &backBatchFitness[begin]);
+        });
+    } else {
+        Chromosome::computeFitness(backBatch.data(), n, backBatchFitness.data());
+    }
+    for (int k = 0; k < n; ++k)
+        backFitness[backReceiver[k]] = backBatchFitness[k];
 
-        size_t size = 1;
-        Chromosome trial(ell);
-        trial = ch;
-	    
-		//2016-03-03
-	    vector<int> takenMask;
+    for (int i = 0; i < nCurrent; ++i) {
+        Chromosome& des = population[orderN[i]];
+        if (backState[i] == BACK_SKIP) {
+            skipBackMixing(des);
+            continue;
+        }
+        backTrials[i].recordFitness(backFitness[i]);
+        if (EQ)
+            acceptBackMixingE(backTrials[i], mask, des);
+        else
+            acceptBackMixing(backTrials[i], mask, des);
+    }
+}
 
-        for (list<int>::iterator it = mask.begin(); it != mask.end(); ++it) {
-            
-            //2016-03-03
-			takenMask.push_back(*it);
+// Chromosome::GHC() on every individual, one bit at a time for the whole
+// population so that every step is a batch. Each individual goes through
+// the evaluations it would go through alone, including the one after a
+// rejected flip; only hitnfe has to be counted as if the individuals had
+// been climbed one after the other.
+void DSMGA2::batchGHC() {
+
+    bool hitBefore = Chromosome::hit;
+    int hitnfeBefore = Chromosome::hitnfe;
+    int nfeBefore = Chromosome::nfe;
+
+    vector<int> evals(nCurrent, 0);
+    vector<int> hitAt(nCurrent, -1);
+    vector<double> original(nCurrent);
+    vector<Chromosome*> batch;
+    vector<int> who;
+
+    auto evaluate = [&]() {
+        Chromosome::evaluateBatch(batch.data(), (int) batch.size());
+        for (size_t k = 0; k < batch.size(); ++k) {
+            int p = who[k];
+            ++evals[p];
+            if (hitAt[p] < 0 && batch[k]->getFitness() > batch[k]->getMaxFitness())
+                hitAt[p] = evals[p];
+        }
+    };
+
+    for (int i = 0; i < ell; ++i) {
+
+        batch.clear();
+        who.clear();
+        for (int p = 0; p < nCurrent; ++p)
+            if (!population[p].isEvaluated()) {
+                batch.push_back(&population[p]);
+                who.push_back(p);
+            }
+        evaluate();
+
+        batch.clear();
+        who.clear();
+        for (int p = 0; p < nCurrent; ++p) {
+            original[p] = population[p].getFitness();
+            population[p].flip(i);
+            batch.push_back(&population[p]);
+            who.push_back(p);
+        }
+        evaluate();
 
-            trial.flip(*it);
+        for (int p = 0; p < nCurrent; ++p)
+            if (!(population[p].getFitness() > original[p]))
+                population[p].flip(i);
+    }
 
-            ++size;
-            if (size > ub) break;
+    Chromosome::hit = hitBefore;
+    Chromosome::hitnfe = hitnfeBefore;
+    if (!hitBefore) {
+        int nfe = nfeBefore;
+        for (int p = 0; p < nCurrent; ++p) {
+            if (hitAt[p] >= 0) {
+                Chromosome::hit = true;
+                Chromosome::hitnfe = nfe + hitAt[p] + Chromosome::lsnfe;
+                break;
+            }
+            nfe += evals[p];
         }
+    }
+}
+
+bool DSMGA2::restrictedMixing(Chromosome& ch, list<int>& mask) {
+
+    bool taken = false;
+    size_t lastUB = 0;
+
+    // trial = ch with the first ub variables of mask flipped, one more per step
+    Chromosome& trial = trialScratch;
+    trial = ch;
+    list<int>::iterator it = mask.begin();
+
+    for (size_t ub = 1; ub <= mask.size(); ++ub, ++it) {
+
+        int node = *it;
+        bool delta = trial.canDelta();
+        double fitness = delta ? trial.deltaFitness(&node, 1) : 0.0;
+        delta = delta && ch.surelyWorse(fitness);
+        trial.flip(node);
 
         //if (isInP(trial)) continue;
         //2016-10-21
         if (isInP(trial)) break;
 
+        if (delta)
+            trial.recordFitness(fitness);
+
         if (trial.getFitness() >= ch.getFitness() - EPSILON) {
             pHash.erase(ch.getKey());
             pHash[trial.getKey()] = trial.getFitness();
 
             taken = true;
-            ch = trial;
+            ch.swap(trial);
+            populationChanged(ch, mask);
         }
 
         if (taken) {
@@ -479,34 +798,84 @@ bool DSMGA2::restrictedMixing(Chromosome& ch, list<int>& mask) {
 
 }
 
-size_t DSMGA2::findSize(Chromosome& ch, list<int>& mask) const {
+// Pulls at most bound variables of the mask from maskGrower into mask,
+// stopping at the first one for which no individual matches ch on the
+// whole prefix any more. The candidate individuals are a bit vector that
+// every variable narrows down with its population column.
+size_t DSMGA2::findSize(Chromosome& ch, list<int>& mask, int bound) {
 
-    DLLA candidate(nCurrent);
-    for (int i=0; i<nCurrent; ++i)
-        candidate.insert(i);
+    resetCandidates();
 
     size_t size = 0;
-    for (list<int>::iterator it = mask.begin(); it != mask.end(); ++it) {
-
-        int allele = ch.getVal(*it);
+    while ((int) mask.size() < bound) {
 
-        for (DLLA::iterator it2 = candidate.begin(); it2 != candidate.end(); ++it2) {
-            if (population[*it2].getVal(*it) == allele)
-                candidate.erase(*it2);
-
-            if (candidate.isEmpty())
-                break;
-        }
+        int node = maskGrower.next();
+        if (node < 0)
+            break;
+        mask.push_back(node);
 
-        if (candidate.isEmpty())
+        if (!dropAgreeing(ch, node))
             break;
 
         ++size;
     }
 
     return size;
+}
+
+// every individual of the population is a candidate
+void DSMGA2::resetCandidates() {
+    candidateBits.assign(popWords, ~0ul);
+    if (remainderLong(nCurrent) != 0)
+        candidateBits[popWords - 1] = (1ul << remainderLong(nCurrent)) - 1;
+}
+
+// drops the candidates that agree with ch on node; whether any are left
+bool DSMGA2::dropAgreeing(const Chromosome& ch, int node) {
+    unsigned long* candidate = &candidateBits[0];
+    const unsigned long* column = &popColumns[(size_t) node * popWords];
+    unsigned long any = 0;
+    if (ch.getVal(node) == 1)
+        for (int w=0; w<popWords; ++w)
+            any |= (candidate[w] &= ~column[w]);
+    else
+        for (int w=0; w<popWords; ++w)
+            any |= (candidate[w] &= column[w]);
+    return any != 0;
+}
+
+// population[k] as bit k of one column per variable, for findSize
+void DSMGA2::buildPopulationColumns() {
 
+    popWords = quotientLong(nCurrent - 1) + 1;
+    popColumns.assign((size_t) ell * popWords, 0ul);
 
+    vector<const unsigned long*> rows(nCurrent);
+    for (int k=0; k<nCurrent; ++k)
+        rows[k] = population[k].getGene();
+    vector<unsigned long*> cols(ell);
+    for (int j=0; j<ell; ++j)
+        cols[j] = &popColumns[(size_t) j * popWords];
+    transposeBits(&rows[0], nCurrent, ell, &cols[0]);
+}
+
+// Called after an individual of the population changed on (some of) the
+// variables in mask.
+void DSMGA2::populationChanged(const Chromosome& ch, const list<int>& mask) {
+
+    if (popColumns.empty() || &ch < population || &ch >= population + nCurrent)
+        return;
+
+    int k = (int) (&ch - population);
+    int q = quotientLong(k);
+    unsigned long bit = 1ul << remainderLong(k);
+    for (list<int>::const_iterator it = mask.begin(); it != mask.end(); ++it) {
+        unsigned long& word = popColumns[(size_t) *it * popWords + q];
+        if (ch.getVal(*it))
+            word |= bit;
+        else
+            word &= ~bit;
+    }
 }
 
 size_t DSMGA2::findSize(Chromosome& ch, list<int>& mask, Chromosome& ch2) const {
@@ -525,12 +894,15 @@ void DSMGA2::mixing() {
         selection();
 
     //* really learn model
-    buildFastCounting();
-    buildGraph();
-    buildGraph_sizecheck();
+    if (!updateGraph()) {
+        buildFastCounting();
+        buildGraph();
+    }
     //for (int i=0; i<ell; ++i)
     //    findClique(i, masks[i]); // replaced by findMask in restrictedMixing
 
+    buildPopulationColumns();
+
     int repeat = (ell>50)? ell/50: 1;
 
     for (int k=0; k<repeat; ++k) {
@@ -560,107 +932,370 @@ inline void DSMGA2::genOrderELL() {
     myRand.uniformArray(orderELL, ell, 0, ell-1);
 }
 
+// Builds both two-edge linkage graphs in a single pass over the pairwise
+// counts. graph_size only differs from graph in the (nfe < 0) MI branch, so
+// it is materialized only then; otherwise findMask_size reads graph directly.
+//
+// The upper triangle is cut into tiles of rowBlock rows by colBlock columns
+// so that the short rows near the bottom do not leave threads idle. Every
+// pair is computed by exactly one tile with the same arithmetic, so the
+// result does not depend on the number of threads.
 void DSMGA2::buildGraph() {
 
-    int *one = new int [ell];
+    clearMaskCache();
+
+    const int nWords = quotientLong(nSample) + 1;
+    const int rowBlock = 64;
+    const int colBlock = 256;
+
+    vector<const unsigned long*> cols(ell);
+    for (int i=0; i<ell; ++i)
+        cols[i] = fastCounting[i].gene;
+
+    oneCount.resize(ell);
+    int *one = &oneCount[0];
     for (int i=0; i<ell; ++i) {
-        one[i] = countOne(i);
+        one[i] = popCount(cols[i], nWords);
     }
 
-    for (int i=0; i<ell; ++i) {
+    countLog.init(nCurrent);
+
+    // sparse mode keeps no pair counts, which would be O(ell^2) again
+    if (SPARSE_K > 0) {
+        buildSparseGraph(cols);
+        countsValid = false;
+        return;
+    }
 
-        for (int j=i+1; j<ell; ++j) {
-
-            int n00, n01, n10, n11;
-            int nX =  countXOR(i, j);
-
-            n11 = (one[i]+one[j]-nX)/2;
-            n10 = one[i] - n11;
-            n01 = one[j] - n11;
-            n00 = nCurrent - n01 - n10 - n11;
-
-            double p00 = (double)n00/(double)nCurrent;
-            double p01 = (double)n01/(double)nCurrent;
-            double p10 = (double)n10/(double)nCurrent;
-            double p11 = (double)n11/(double)nCurrent;
-            double p1_ = p10 + p11;
-            double p0_ = p00 + p01;
-            double p_0 = p00 + p10;
-            double p_1 = p01 + p11;
-
-            double linkage = computeMI(p00,p01,p10,p11);
-            
-            //2016-04-08_computeMI_entropy
-            double linkage00 = 0.0, linkage01 = 0.0;
-            if (p00 > EPSILON)
-                linkage00 += p00*log(p00/p_0/p0_);
-            if (p11 > EPSILON)
-                linkage00 += p11*log(p11/p_1/p1_);
-            if (p01 > EPSILON)
-                linkage01 += p01*log(p01/p0_/p_1);
-            if (p10 > EPSILON)
-                linkage01 += p10*log(p10/p1_/p_0);
-           
-            if(Chromosome::nfe < 0){
-                pair<double, double> p(linkage, linkage);
-                graph.write(i, j, p);
+    // a sample, even one grown to the whole population, is redrawn every
+    // generation, so its counts are never carried over
+    bool incremental = INCREMENTAL && !sampling();
+    if (incremental)
+        pairN11.resize((size_t) ell * (ell - 1) / 2);
+
+    bool shared = (Chromosome::nfe >= 0);
+    if (!shared && sizeGraphShared) {
+        if (ROW_LINKAGE)
+            rowGraph_size.init(ell, HUGE_PAGES);
+        else
+            graph_size.init(ell, HUGE_PAGES);
+    }
+    sizeGraphShared = shared;
+
+    // (i0, j0) of every tile touching the upper triangle
+    vector<pair<int, int> > tiles;
+    for (int i0=0; i0<ell; i0+=rowBlock)
+        for (int j0=i0; j0<ell; j0+=colBlock)
+            tiles.push_back(pair<int, int>(i0, j0));
+
+    int nWorkers = (pool != NULL) ? pool->size() : 1;
+    vector<vector<int> > n11(nWorkers, vector<int>(rowBlock * colBlock));
+
+    auto buildTile = [&](int t, int worker) {
+        int i0 = tiles[t].first, j0 = tiles[t].second;
+        int i1 = min(i0 + rowBlock, ell);
+        int j1 = min(j0 + colBlock, ell);
+        int *count = &n11[worker][0];
+
+        pairCount(&cols[0], nWords, i0, i1, j0, j1, PAIR_AND, count, colBlock);
+
+        for (int i=i0; i<i1; ++i)
+            for (int j=max(i+1, j0); j<j1; ++j) {
+                int c = count[(i-i0)*colBlock + (j-j0)];
+                if (incremental)
+                    pairN11[pairIndex(i, j)] = c;
+                writeLinkage(i, j, one[i], one[j], c);
             }
-            else{
-                pair<double, double> p(linkage00, linkage01);
-                graph.write(i, j, p);
+    };
+
+    if (pool != NULL)
+        pool->run((int) tiles.size(), buildTile);
+    else
+        for (int t=0; t<(int) tiles.size(); ++t)
+            buildTile(t, 0);
+
+    // remember which rows these counts describe
+    countsValid = incremental;
+    countsShared = shared;
+    if (countsValid) {
+        int rowWords = population[0].getLengthLong();
+        countedRows.resize((size_t) nCurrent * rowWords);
+        countedKeys.resize(nCurrent);
+        for (int k=0; k<nCurrent; ++k) {
+            const Chromosome& ch = selected(k);
+            copy(ch.getGene(), ch.getGene() + rowWords, &countedRows[(size_t) k * rowWords]);
+            countedKeys[k] = ch.getKey();
+        }
+    }
+
+}
+
+// Brings the stored pair counts up to date with the rows selected this
+// generation and rewrites only the linkage of pairs whose counts moved.
+// The counts do not depend on the order of the rows, so identical rows
+// are matched up first and only the leftover rows are diffed bit by bit.
+// Returns false when a full rebuild is needed or would be cheaper.
+POPCNT_CLONES
+bool DSMGA2::updateGraph() {
+
+    if (!INCREMENTAL || !countsValid || SPARSE_K > 0 || sampling())
+        return false;
+    if (countsShared != (Chromosome::nfe >= 0))
+        return false;
+
+    const int rowWords = population[0].getLengthLong();
+
+    unordered_multimap<unsigned long, int> unmatched;
+    for (int k=0; k<nCurrent; ++k)
+        unmatched.insert(make_pair(countedKeys[k], k));
+
+    vector<int> fresh;
+    for (int k=0; k<nCurrent; ++k) {
+        const Chromosome& ch = selected(k);
+        bool matched = false;
+        auto range = unmatched.equal_range(ch.getKey());
+        for (auto it = range.first; it != range.second; ++it) {
+            const unsigned long* row = &countedRows[(size_t) it->second * rowWords];
+            if (equal(row, row + rowWords, ch.getGene())) {
+                unmatched.erase(it);
+                matched = true;
+                break;
             }
-				
         }
+        if (!matched)
+            fresh.push_back(k);
     }
 
+    vector<int> stale;
+    for (auto it = unmatched.begin(); it != unmatched.end(); ++it)
+        stale.push_back(it->second);
+    sort(stale.begin(), stale.end());
+
+    // each changed bit costs about one pass over a row of counts; past
+    // that point the blocked kernel is the faster way to get them
+    long changed = 0;
+    for (size_t t=0; t<fresh.size(); ++t) {
+        const unsigned long* oldRow = &countedRows[(size_t) stale[t] * rowWords];
+        const unsigned long* newRow = selected(fresh[t]).getGene();
+        for (int w=0; w<rowWords; ++w)
+            changed += myBD.countOne(oldRow[w] ^ newRow[w]);
+    }
+    if (changed * 64 > (long) ell * nCurrent)
+        return false;
 
-    delete []one;
+    vector<char> dirty(ell, 0);
+    for (size_t t=0; t<fresh.size(); ++t) {
+        const Chromosome& ch = selected(fresh[t]);
+        unsigned long* row = &countedRows[(size_t) stale[t] * rowWords];
+        applyRowDelta(row, ch.getGene(), dirty);
+        copy(ch.getGene(), ch.getGene() + rowWords, row);
+        countedKeys[stale[t]] = ch.getKey();
+    }
+
+    vector<int> rows;
+    for (int i=0; i<ell; ++i)
+        if (dirty[i]) rows.push_back(i);
+
+    // a pair with both ends dirty is rewritten by its smaller end only
+    auto rewriteRow = [&](int t, int) {
+        int i = rows[t];
+        for (int j=0; j<ell; ++j) {
+            if (j == i || (dirty[j] && j < i))
+                continue;
+            int a = min(i, j), b = max(i, j);
+            writeLinkage(a, b, oneCount[a], oneCount[b], pairN11[pairIndex(i, j)]);
+        }
+    };
 
+    if (pool != NULL)
+        pool->run((int) rows.size(), rewriteRow);
+    else
+        for (int t=0; t<(int) rows.size(); ++t)
+            rewriteRow(t, 0);
+
+    clearMaskCache();
+    return true;
 }
-void DSMGA2::buildGraph_sizecheck() {
-    int *one = new int [ell];
-    for (int i=0; i<ell; ++i) {
-        one[i] = countOne(i);
+
+void DSMGA2::applyRowDelta(const unsigned long* oldRow, const unsigned long* newRow, vector<char>& dirty) {
+
+    const int rowWords = population[0].getLengthLong();
+    const int bits = sizeof(unsigned long) * 8;
+
+    for (int w=0; w<rowWords; ++w) {
+        for (unsigned long d = oldRow[w] ^ newRow[w]; d != 0; d &= d - 1) {
+            int i = w * bits + __builtin_ctzl(d);
+            unsigned long bit = 1lu << remainderLong(i);
+            int delta = (newRow[w] & bit) ? 1 : -1;
+            const unsigned long* row = (delta > 0) ? newRow : oldRow;
+
+            oneCount[i] += delta;
+            dirty[i] = 1;
+
+            // n11(i,j) moves with every j set in the row that carries i;
+            // pairs of two changed bits are counted from their smaller end
+            for (int v=0; v<rowWords; ++v) {
+                unsigned long skip = (oldRow[v] ^ newRow[v]) & ((v < w) ? ~0lu : (v == w) ? (bit | (bit - 1)) : 0lu);
+                for (unsigned long r = row[v] & ~skip; r != 0; r &= r - 1) {
+                    int j = v * bits + __builtin_ctzl(r);
+                    pairN11[pairIndex(i, j)] += delta;
+                }
+            }
+        }
     }
+}
 
-    for (int i=0; i<ell; ++i) {
-        for (int j=i+1; j<ell; ++j) {
-            int n00, n01, n10, n11;
-            int nX =  countXOR(i, j);
-
-            n11 = (one[i]+one[j]-nX)/2;
-            n10 = one[i] - n11;
-            n01 = one[j] - n11;
-            n00 = nCurrent - n01 - n10 - n11;
-
-            double p00 = (double)n00/(double)nCurrent;
-            double p01 = (double)n01/(double)nCurrent;
-            double p10 = (double)n10/(double)nCurrent;
-            double p11 = (double)n11/(double)nCurrent;
-            double p1_ = p10 + p11;
-            double p0_ = p00 + p01;
-            double p_0 = p00 + p10;
-            double p_1 = p01 + p11;
-
-            double linkage = computeMI(p00,p01,p10,p11);
-            
-            // Use the linkage variables
-            double linkage00 = 0.0, linkage01 = 0.0;
-            if (p00 > EPSILON)
-                linkage00 += p00*log(p00/p_0/p0_);
-            if (p11 > EPSILON)
-                linkage00 += p11*log(p11/p_1/p1_);
-            if (p01 > EPSILON)
-                linkage01 += p01*log(p01/p0_/p_1);
-            if (p10 > EPSILON)
-                linkage01 += p10*log(p10/p1_/p_0);
-
-            pair<double, double> p(linkage00, linkage01);
+const Chromosome& DSMGA2::selected(int k) const {
+    return SELECTION ? population[selectionIndex[k]] : population[k];
+}
+
+// packed index of the pair (i, j), same layout as TriMatrix
+size_t DSMGA2::pairIndex(int i, int j) const {
+    return TriMatrix<int>::index(i, j);
+}
+
+// p_ab*log(p_ab/(p_a_*p__b)) = n_ab*(log n_ab + log N - log n_a_ - log n__b)/N,
+// so the two-edge linkage only needs table lookups
+pair<double, double> DSMGA2::twoEdgeLinkage(int oneI, int oneJ, int n11) const {
+
+    int n10 = oneI - n11;
+    int n01 = oneJ - n11;
+    int n00 = nSample - n01 - n10 - n11;
+
+    double logN = countLog.log(nSample);
+    double log0_ = countLog.log(nSample - oneI);
+    double log1_ = countLog.log(oneI);
+    double log_0 = countLog.log(nSample - oneJ);
+    double log_1 = countLog.log(oneJ);
+
+    //2016-04-08_computeMI_entropy
+    double linkage00 = 0.0, linkage01 = 0.0;
+    if (n00 > 0)
+        linkage00 += n00*(countLog.log(n00) + logN - log_0 - log0_);
+    if (n11 > 0)
+        linkage00 += n11*(countLog.log(n11) + logN - log_1 - log1_);
+    if (n01 > 0)
+        linkage01 += n01*(countLog.log(n01) + logN - log0_ - log_1);
+    if (n10 > 0)
+        linkage01 += n10*(countLog.log(n10) + logN - log1_ - log_0);
+
+    return pair<double, double>(linkage00 / nSample, linkage01 / nSample);
+}
+
+void DSMGA2::writeLinkage(int i, int j, int oneI, int oneJ, int n11) {
+
+    pair<double, double> p = twoEdgeLinkage(oneI, oneJ, n11);
+    if (sizeGraphShared) {
+        if (ROW_LINKAGE)
+            rowGraph.write(i, j, p);
+        else
+            graph.write(i, j, p);
+    } else {
+        int n10 = oneI - n11;
+        int n01 = oneJ - n11;
+        double linkage = computeMI(nSample - n01 - n10 - n11, n01, n10, n11);
+        if (ROW_LINKAGE) {
+            rowGraph.write(i, j, pair<double, double>(linkage, linkage));
+            rowGraph_size.write(i, j, p);
+        } else {
+            graph.write(i, j, pair<double, double>(linkage, linkage));
             graph_size.write(i, j, p);
         }
     }
+}
+
+// Sparse mode: every pair of the upper triangle is computed once and
+// offered to both of its ends, of which only the SPARSE_K strongest
+// neighbours by either edge type are kept. The row ends collect their
+// offers over the block, the column ends get them per tile, both under
+// the node's lock; the top k under the (key, j) order do not depend on
+// the order of the offers. The MI variant of the (nfe < 0) branch is
+// not kept, both mask growths use the two-edge weights.
+void DSMGA2::buildSparseGraph(const vector<const unsigned long*>& cols) {
+
+    const int nWords = fastCounting[0].lengthLong;
+    const int rowBlock = 64;
+    const int colBlock = 256;
+    const int k = min(SPARSE_K, ell - 1);
+    const int *one = &oneCount[0];
+
+    typedef SparseGraph<double>::Edge Edge;
+    typedef pair<pair<double, int>, pair<double, double> > Ranked;  // ((key, j), weights)
+
+    vector<vector<Ranked> > top00(ell), top01(ell);
+    vector<mutex> lock(ell);
+    int nBlocks = (ell + rowBlock - 1) / rowBlock;
+    int nWorkers = (pool != NULL) ? pool->size() : 1;
+    vector<vector<int> > n11(nWorkers, vector<int>(rowBlock * colBlock));
+    vector<vector<pair<double, double> > > weight(nWorkers, vector<pair<double, double> >(rowBlock * colBlock));
+
+    // min-heaps on the key, so the weakest kept neighbour is on top
+    auto keep = [k](vector<Ranked>& top, const Ranked& r) {
+        if ((int) top.size() < k) {
+            top.push_back(r);
+            push_heap(top.begin(), top.end(), greater<Ranked>());
+        } else if (r.first > top.front().first) {
+            pop_heap(top.begin(), top.end(), greater<Ranked>());
+            top.back() = r;
+            push_heap(top.begin(), top.end(), greater<Ranked>());
+        }
+    };
+
+    auto buildBlock = [&](int b, int worker) {
+        int i0 = b * rowBlock;
+        int i1 = min(i0 + rowBlock, ell);
+        int *count = &n11[worker][0];
+        pair<double, double> *w = &weight[worker][0];
+        vector<vector<Ranked> > row00(i1 - i0), row01(i1 - i0);
+
+        for (int j0=i0; j0<ell; j0+=colBlock) {
+            int j1 = min(j0 + colBlock, ell);
+            pairCount(&cols[0], nWords, i0, i1, j0, j1, PAIR_AND, count, colBlock);
+
+            for (int i=i0; i<i1; ++i)
+                for (int j=max(i+1, j0); j<j1; ++j) {
+                    int t = (i-i0)*colBlock + (j-j0);
+                    w[t] = twoEdgeLinkage(one[i], one[j], count[t]);
+                    keep(row00[i-i0], Ranked(make_pair(w[t].first, j), w[t]));
+                    keep(row01[i-i0], Ranked(make_pair(w[t].second, j), w[t]));
+                }
+
+            // the column ends get the tile's offers under one lock each
+            for (int j=j0+1; j<j1; ++j) {
+                lock_guard<mutex> guard(lock[j]);
+                for (int i=i0; i<min(i1, j); ++i) {
+                    const pair<double, double>& wij = w[(i-i0)*colBlock + (j-j0)];
+                    keep(top00[j], Ranked(make_pair(wij.first, i), wij));
+                    keep(top01[j], Ranked(make_pair(wij.second, i), wij));
+                }
+            }
+        }
+
+        for (int i=i0; i<i1; ++i) {
+            lock_guard<mutex> guard(lock[i]);
+            for (size_t t=0; t<row00[i-i0].size(); ++t)
+                keep(top00[i], row00[i-i0][t]);
+            for (size_t t=0; t<row01[i-i0].size(); ++t)
+                keep(top01[i], row01[i-i0][t]);
+        }
+    };
+
+    if (pool != NULL)
+        pool->run(nBlocks, buildBlock);
+    else
+        for (int b=0; b<nBlocks; ++b)
+            buildBlock(b, 0);
+
+    vector<vector<Edge> > candidates(ell);
+    for (int i=0; i<ell; ++i) {
+        vector<Edge>& edges = candidates[i];
+        for (size_t t=0; t<top00[i].size(); ++t)
+            edges.push_back(Edge(top00[i][t].first.second, top00[i][t].second));
+        for (size_t t=0; t<top01[i].size(); ++t)
+            edges.push_back(Edge(top01[i][t].first.second, top01[i][t].second));
+    }
 
-    delete []one;
+    sparseGraph.build(candidates);
 }
 
 
@@ -670,37 +1305,19 @@ void DSMGA2::findClique(int startNode, list<int>& result) {
    }
 
     
-    double DSMGA2::computeMI(double a00, double a01, double a10, double a11) const {
-
-    double p0 = a00 + a01;
-    double q0 = a00 + a10;
-    double p1 = 1-p0;
-    double q1 = 1-q0;
-
-    double join = 0.0;
-    if (a00 > EPSILON)
-        join += a00*log(a00);
-    if (a01 > EPSILON)
-        join += a01*log(a01);
-    if (a10 > EPSILON)
-        join += a10*log(a10);
-    if (a11 > EPSILON)
-        join += a11*log(a11);
-
-    double p = 0.0;
-    if (p0 > EPSILON)
-        p += p0*log(p0);
-    if (p1 > EPSILON)
-        p += p1*log(p1);
-
-
-    double q = 0.0;
-    if (q0 > EPSILON)
-        q += q0*log(q0);
-    if (q1 > EPSILON)
-        q += q1*log(q1);
-
-    return -p-q+join;
+// mutual information of a pair from its counts:
+// (sum n log n over the joint - over both marginals)/N + log N
+double DSMGA2::computeMI(int n00, int n01, int n10, int n11) const {
+
+    int n0_ = n00 + n01;
+    int n_0 = n00 + n10;
+
+    double join = countLog.nLogN(n00) + countLog.nLogN(n01)
+                + countLog.nLogN(n10) + countLog.nLogN(n11);
+    double p = countLog.nLogN(n0_) + countLog.nLogN(nSample - n0_);
+    double q = countLog.nLogN(n_0) + countLog.nLogN(nSample - n_0);
+
+    return (join - p - q) / nSample + countLog.log(nSample);
 
 }
 
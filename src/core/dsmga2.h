@@ -12,8 +12,14 @@
 #include "chromosome.h"
 #include "statistics.h"
 #include "trimatrix.h"
+#include "linkagerows.h"
+#include "genearena.h"
 #include "doublelinkedlistarray.h"
 #include "fastcounting.h"
+#include "threadpool.h"
+#include "countlog.h"
+#include "sparsegraph.h"
+#include "maskgrower.h"
 #include <pybind11/pybind11.h>
 #include <functional>
 #include <vector>
@@ -25,7 +31,10 @@ public:
            int n_nInitial, 
            int n_maxGen, 
            int n_maxFe, 
-           std::function<double(const Chromosome&)> customFn);
+           std::function<double(const Chromosome&)> customFn,
+           Chromosome::BatchFunction batchFn = nullptr,
+           Chromosome::DeltaFunction deltaFn = nullptr,
+           Chromosome::NeighbourFunction neighbourFn = nullptr);
 
     ~DSMGA2();
 
@@ -38,11 +47,12 @@ public:
     
     void findMask(Chromosome& ch, std::list<int>& mask, int startNode);
     void findMask_size(Chromosome& ch, std::list<int>& mask, int startNode, int bound);
-    void buildGraph_sizecheck();
     void restrictedMixing(Chromosome&);
     bool restrictedMixing(Chromosome& ch, std::list<int>& mask);
     void backMixing(Chromosome& source, std::list<int>& mask, Chromosome& des);
     void backMixingE(Chromosome& source, std::list<int>& mask, Chromosome& des);
+    void batchBackMixing(Chromosome& source, std::list<int>& mask);
+    void batchGHC();
 
     bool shouldTerminate();
     bool foundOptima();
@@ -87,19 +97,92 @@ public:
     int bestIndex;
 
     Chromosome* population;
+    GeneArena popArena;             // the genes of population, one row each
     FastCounting* fastCounting;
 
     TriMatrix<double> graph;
     TriMatrix<double> graph_size;
+    LinkageRows rowGraph;
+    LinkageRows rowGraph_size;
+    SparseGraph<double> sparseGraph;
+    MaskGrower maskGrower;
+
+    // masks grown this generation, by ch.getKey() ^ zKey[startNode],
+    // for graph and graph_size, as far as findSize grew them
+    struct MaskCacheEntry {
+        int startNode;
+        unsigned long chKey;
+        std::vector<int> mask;
+    };
+    std::unordered_map<unsigned long, MaskCacheEntry> maskCache[2];
+
+    // the current population by variable, kept in sync with every
+    // replacement during mixing
+    int popWords;
+    std::vector<unsigned long> popColumns;
+    std::vector<unsigned long> candidateBits;
+
+    // back mixing: the mask as packed words and a reusable trial
+    std::vector<unsigned long> maskWords;
+    Chromosome trialScratch;
+    long skippedTrials;     // back-mixing trials that would not change anything
+
+    // batched back mixing: one trial per receiver in orderN order
+    enum { BACK_EVALUATE, BACK_SKIP, BACK_DELTA };
+    std::vector<Chromosome> backTrials;
+    std::vector<char> backState;
+    std::vector<double> backFitness;
+    std::vector<const Chromosome*> backBatch;
+    std::vector<int> backReceiver;
+    std::vector<double> backBatchFitness;
+    CountLog countLog;
+    int nSample;        // rows fastCounting was filled from
+    bool sizeGraphShared;
+    ThreadPool* pool;
+
+    // integer statistics of the selected rows the graph was built from,
+    // kept so that the next generation can be applied as a delta
+    bool countsValid;
+    bool countsShared;
+    std::vector<int> pairN11;
+    std::vector<int> oneCount;
+    std::vector<unsigned long> countedRows;
+    std::vector<unsigned long> countedKeys;
+
     double previousFitnessMean;
     Statistics stFitness;
 
-    double computeMI(double, double, double, double) const;
+    double computeMI(int, int, int, int) const;
     void findClique(int startNode, std::list<int>& result);
     void buildFastCounting();
+    bool sampling() const;
+    void transposeColumns(const std::vector<const unsigned long*>& rows);
+    void sampleFastCounting();
+    void addSampleRows(const std::vector<int>& slot, int n);
+    void probeLinkage(const std::vector<std::pair<int, int> >& probe, std::vector<std::pair<double, double> >& result) const;
+    std::pair<double, double> twoEdgeLinkage(int oneI, int oneJ, int n11) const;
+    void writeLinkage(int i, int j, int oneI, int oneJ, int n11);
+    void buildSparseGraph(const std::vector<const unsigned long*>& cols);
+    bool updateGraph();
+    void applyRowDelta(const unsigned long* oldRow, const unsigned long* newRow, std::vector<char>& dirty);
+    const Chromosome& selected(int k) const;
+    size_t pairIndex(int i, int j) const;
     int countXOR(int, int) const;
     int countOne(int) const;
-    size_t findSize(Chromosome&, std::list<int>&) const;
+    void startMask(Chromosome& ch, int startNode, bool sizeGraph);
+    size_t findMaskAndSize(Chromosome& ch, int startNode, bool sizeGraph, int bound, std::list<int>& mask);
+    void clearMaskCache();
+    void buildPopulationColumns();
+    void packMask(const std::list<int>& mask);
+    void populationChanged(const Chromosome& ch, const std::list<int>& mask);
+    bool makeTrial(Chromosome& trial, const Chromosome& source, const Chromosome& des, double& fitness) const;
+    void skipBackMixing(Chromosome& des);
+    void acceptBackMixing(Chromosome& trial, std::list<int>& mask, Chromosome& des);
+    void acceptBackMixingE(Chromosome& trial, std::list<int>& mask, Chromosome& des);
+    size_t findSize(Chromosome&, std::list<int>&, int bound);
+    bool replaySize(Chromosome& ch, const std::vector<int>& grown, int bound, std::list<int>& mask, size_t& size);
+    void resetCandidates();
+    bool dropAgreeing(const Chromosome& ch, int node);
     size_t findSize(Chromosome&, std::list<int>&, Chromosome&) const;
 
     double lastMax, lastMean, lastMin;
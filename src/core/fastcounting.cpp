@@ -19,6 +19,7 @@
  ***************************************************************************/
 
 #include <cstring>
+#include <utility>
 #include "global.h"
 #include "fastcounting.h"
 
@@ -35,6 +36,22 @@ FastCounting::FastCounting (int n_length) {
     init (n_length);
 }
 
+FastCounting::FastCounting (const FastCounting& c) {
+    length = 0;
+    lengthLong = 0;
+    gene = NULL;
+
+    *this = c;
+}
+
+FastCounting::FastCounting (FastCounting&& c) noexcept {
+    length = 0;
+    lengthLong = 0;
+    gene = NULL;
+
+    swap (c);
+}
+
 
 FastCounting::~FastCounting () {
     if (gene != NULL) delete []gene;
@@ -107,7 +124,10 @@ void FastCounting::setVal (int index, int val) {
 
 FastCounting& FastCounting::operator= (const FastCounting& c) {
 
-    if (length != c.length) {
+    if (this == &c)
+        return *this;
+
+    if (gene == NULL || length != c.length) {
         length = c.length;
         init (length);
     }
@@ -119,6 +139,17 @@ FastCounting& FastCounting::operator= (const FastCounting& c) {
     return *this;
 }
 
+FastCounting& FastCounting::operator= (FastCounting&& c) noexcept {
+    swap (c);
+    return *this;
+}
+
+void FastCounting::swap (FastCounting& c) noexcept {
+    std::swap (gene, c.gene);
+    std::swap (length, c.length);
+    std::swap (lengthLong, c.lengthLong);
+}
+
 int FastCounting::makeInt (int *bb) const {
     int value = 0;
 
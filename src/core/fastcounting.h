@@ -15,6 +15,8 @@ class FastCounting {
 public:
     FastCounting ();
     FastCounting (int n_ell);
+    FastCounting (const FastCounting& c);
+    FastCounting (FastCounting&& c) noexcept;
 
     ~FastCounting ();
 
@@ -24,6 +26,9 @@ public:
     void setVal (int index, int val);
 
     FastCounting& operator= (const FastCounting& c);
+    FastCounting& operator= (FastCounting&& c) noexcept;
+
+    void swap (FastCounting& c) noexcept;
 
     int makeInt (int *bb) const;
 
@@ -19,7 +19,21 @@ int maxMemory = 0;
 bool GHC = true;
 bool SELECTION = true;
 bool CACHE = false;
+bool MASK_CACHE = true;    // reuse restricted-mixing masks within a generation
 bool SHOW_BISECTION = true;
+int THREADS = 1;    // worker threads for model building
+bool INCREMENTAL = true;    // update pair counts from changed rows instead of rebuilding
+bool PARALLEL_BACKMIXING = false;    // evaluate back-mixing trials on the worker threads; needs a thread-safe fitness function
+bool DELTA_EVAL = false;    // score flips and back-mixing trials from the subfunctions they touch
+bool STEEPEST_GHC = false;    // initial climb by steepest ascent on flip gains instead of one first-improvement pass
+bool HUGE_PAGES = false;    // back the linkage graph with transparent huge pages
+bool ROW_LINKAGE = false;    // keep the linkage graph as full float rows for vectorized mask growth
+int SPARSE_K = 0;    // > 0: keep only the k strongest neighbours per variable and edge type
+int SAMPLE_SIZE = 0;    // > 0: estimate linkage from this many random selected rows
+bool SAMPLE_GROW = false;    // double the sample until the linkage estimates settle
+double SAMPLE_TOLERANCE = 0.01;    // largest probe linkage change that counts as settled
+unsigned long ZOBRIST_SEED = ZKey::DEFAULT_SEED;    // seed of the Zobrist keys
+const char* ZOBRIST_FILE = NULL;    // read the keys from this genZobrist file instead, as older runs did
 
 char outputFilename[100];
 Chromosome::Function Chromosome::function;
@@ -46,3 +60,45 @@ int pow2(int x) {
     return (1 << x);
 }
 
+static void envFlag(const char* name, bool& flag) {
+    const char* v = getenv(name);
+    if (v != NULL)
+        flag = (atoi(v) != 0);
+}
+
+static void envInt(const char* name, int& x) {
+    const char* v = getenv(name);
+    if (v != NULL)
+        x = atoi(v);
+}
+
+static void envDouble(const char* name, double& x) {
+    const char* v = getenv(name);
+    if (v != NULL)
+        x = atof(v);
+}
+
+// DSMGA2_<SWITCH>=value overrides the switch of that name, e.g.
+// DSMGA2_SPARSE_K=16; an empty DSMGA2_ZOBRIST_FILE means none
+void readEnvOptions() {
+    envFlag("DSMGA2_MASK_CACHE", MASK_CACHE);
+    envInt("DSMGA2_THREADS", THREADS);
+    envFlag("DSMGA2_INCREMENTAL", INCREMENTAL);
+    envFlag("DSMGA2_PARALLEL_BACKMIXING", PARALLEL_BACKMIXING);
+    envFlag("DSMGA2_DELTA_EVAL", DELTA_EVAL);
+    envFlag("DSMGA2_STEEPEST_GHC", STEEPEST_GHC);
+    envFlag("DSMGA2_HUGE_PAGES", HUGE_PAGES);
+    envFlag("DSMGA2_ROW_LINKAGE", ROW_LINKAGE);
+    envInt("DSMGA2_SPARSE_K", SPARSE_K);
+    envInt("DSMGA2_SAMPLE_SIZE", SAMPLE_SIZE);
+    envFlag("DSMGA2_SAMPLE_GROW", SAMPLE_GROW);
+    envDouble("DSMGA2_SAMPLE_TOLERANCE", SAMPLE_TOLERANCE);
+
+    const char* v = getenv("DSMGA2_ZOBRIST_SEED");
+    if (v != NULL)
+        ZOBRIST_SEED = strtoul(v, NULL, 0);
+    v = getenv("DSMGA2_ZOBRIST_FILE");
+    if (v != NULL)
+        ZOBRIST_FILE = (*v != '\0') ? v : NULL;
+}
+
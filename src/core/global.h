@@ -26,12 +26,27 @@
 extern bool GHC;
 extern bool SELECTION;
 extern bool CACHE;
+extern bool MASK_CACHE;
 extern bool SHOW_BISECTION;
+extern int THREADS;
+extern bool INCREMENTAL;
+extern bool PARALLEL_BACKMIXING;
+extern bool DELTA_EVAL;
+extern bool STEEPEST_GHC;
+extern bool HUGE_PAGES;
+extern bool ROW_LINKAGE;
+extern int SPARSE_K;
+extern int SAMPLE_SIZE;
+extern bool SAMPLE_GROW;
+extern double SAMPLE_TOLERANCE;
+extern unsigned long ZOBRIST_SEED;
+extern const char* ZOBRIST_FILE;
 
 extern char outputFilename[100];
 extern void gstop ();
 extern void outputErrMsg (const char *errMsg);
 extern int pow2 (int x);
+extern void readEnvOptions ();
 
 extern ZKey zKey;
 extern MyRand myRand;
@@ -0,0 +1,135 @@
+/***************************************************************************
+ *   Local search on flip gains.                                           *
+ ***************************************************************************/
+
+#include "global.h"
+#include "localsearch.h"
+
+using namespace std;
+
+
+bool LocalSearch::available() {
+    return DELTA_EVAL && Chromosome::deltaFunction != nullptr;
+}
+
+// Without a delta function the gain is a full evaluation of the flipped
+// trial against the current fitness. trialFitness is the flipped trial's
+// fitness either way.
+double LocalSearch::gainOf(const Chromosome& ch, int i) {
+    if (available()) {
+        double g = Chromosome::deltaFunction(ch, &i, 1);
+        trialFitness = current + g;
+        return g;
+    }
+    trial = ch;
+    trial.flip(i);
+    trialFitness = trial.computeFitness();
+    return trialFitness - current;
+}
+
+// Chromosome::hit, as the evaluation of the move just made would set it.
+// Right at the threshold the deltas summed into current are not trusted
+// with the last bits, and the evaluation is made in full.
+void LocalSearch::checkHit(const Chromosome& ch) {
+    if (Chromosome::hit)
+        return;
+    double f = current;
+    if (fabs(f - ch.getMaxFitness()) <= EPSILON)
+        f = ch.computeFitness();
+    if (f > ch.getMaxFitness()) {
+        Chromosome::hit = true;
+        Chromosome::hitnfe = Chromosome::nfe + Chromosome::lsnfe;
+    }
+}
+
+// ch keeps the fitness a full evaluation of it gives, to the last bit, as
+// every fitness that is kept; current is that already unless it was summed
+// from deltas. Its evaluations have been counted move by move.
+void LocalSearch::finish(Chromosome& ch) {
+    if (!ch.isEvaluated())
+        ch.recordFitness(available() ? ch.computeFitness() : current, false);
+}
+
+bool LocalSearch::firstImprovement(Chromosome& ch) {
+
+    const int ell = ch.getLength();
+    current = ch.getFitness();
+
+    bool improved = false;
+    for (int i = 0; i < ell; ++i) {
+        double g = gainOf(ch, i);
+        ++Chromosome::nfe;          // the flipped trial
+        if (g > EPSILON) {
+            ch.flip(i);
+            current = trialFitness;
+            improved = true;
+            checkHit(ch);
+        } else if (i < ell - 1)
+            ++Chromosome::nfe;      // and flipping it back
+        else {
+            // tryFlipping leaves the last flip taken back unevaluated,
+            // for the next getFitness() to count, after any later hit
+            ch.flip(i);
+            ch.flip(i);
+            return improved;
+        }
+    }
+
+    finish(ch);
+    return improved;
+}
+
+bool LocalSearch::steepestAscent(Chromosome& ch) {
+
+    const int ell = ch.getLength();
+    current = ch.getFitness();
+    const bool local = available() && Chromosome::neighbourFunction != nullptr;
+
+    gain.resize(ell);
+    for (int i = 0; i < ell; ++i) {
+        ++Chromosome::lsnfe;
+        gain[i] = gainOf(ch, i);
+    }
+
+    bool improved = false;
+    while (true) {
+
+        int best = 0;
+        for (int i = 1; i < ell; ++i)
+            if (gain[best] < gain[i])
+                best = i;
+        if (!(gain[best] > EPSILON))
+            break;
+
+        ch.flip(best);
+        improved = true;
+
+        if (!local) {
+            if (available()) {
+                current += gain[best];
+            } else {
+                ++Chromosome::lsnfe;
+                current = ch.computeFitness();
+            }
+            checkHit(ch);
+            for (int i = 0; i < ell; ++i) {
+                ++Chromosome::lsnfe;
+                gain[i] = gainOf(ch, i);
+            }
+            continue;
+        }
+
+        current += gain[best];
+        checkHit(ch);
+        gain[best] = -gain[best];
+        neighbours.clear();
+        Chromosome::neighbourFunction(ell, best, neighbours);
+        for (size_t k = 0; k < neighbours.size(); ++k) {
+            ++Chromosome::lsnfe;
+            gain[neighbours[k]] = gainOf(ch, neighbours[k]);
+        }
+    }
+
+    finish(ch);
+    return improved;
+}
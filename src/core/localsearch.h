@@ -0,0 +1,60 @@
+/***************************************************************************
+ *   Local search on flip gains.                                           *
+ *                                                                         *
+ *   The gain of a variable is the fitness change flipping it would make,  *
+ *   taken from Chromosome::deltaFunction, so it only looks at the         *
+ *   subfunctions the variable is in. A flip is only taken when it gains   *
+ *   more than EPSILON, so a neutral flip is never taken on the rounding   *
+ *   of the deltas. Evaluations are counted where the moves are made, and  *
+ *   the hit is recorded at the move that reaches the optimum.             *
+ ***************************************************************************/
+
+#ifndef _LOCALSEARCH_H_
+#define _LOCALSEARCH_H_
+
+#include <vector>
+
+#include "chromosome.h"
+
+
+class LocalSearch {
+
+public:
+
+    /** whether gains can come from deltaFunction (DELTA_EVAL is on) */
+    static bool available();
+
+    /**
+     *  One pass in variable order keeping every flip that gains, the
+     *  moves Chromosome::GHC() makes. Counted in nfe as GHC() counts its
+     *  full evaluations: one per flip and one more per flip taken back,
+     *  the last of which is left to the next getFitness() of ch.
+     */
+    bool firstImprovement(Chromosome& ch);
+
+    /**
+     *  Flips the variable with the largest gain until no flip gains.
+     *  After a flip only the gains of its neighbours are asked for again
+     *  (all of them without Chromosome::neighbourFunction). Every gain
+     *  asked for counts as one local-search evaluation (Chromosome::lsnfe).
+     */
+    bool steepestAscent(Chromosome& ch);
+
+private:
+
+    double gainOf(const Chromosome& ch, int i);
+    void checkHit(const Chromosome& ch);
+    void finish(Chromosome& ch);
+
+    std::vector<double> gain;
+    std::vector<int> neighbours;
+
+    // the fitness of ch and of the last trial
+    Chromosome trial;
+    double current;
+    double trialFitness;
+
+};
+
+
+#endif
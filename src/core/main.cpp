@@ -17,8 +17,8 @@
 using namespace std;
 
 int main(int argc, char *argv[]) {
-    if (argc != 9) {
-        printf("Usage: DSMGA2 <problemSize> <initialPopulation> <fitnessType> <maxGenerations> <maxEvaluations> <repeats> <display> <randomSeed>\n");
+    if (argc != 9 && argc != 10) {
+        printf("Usage: DSMGA2 <problemSize> <initialPopulation> <fitnessType> <maxGenerations> <maxEvaluations> <repeats> <display> <randomSeed> [threads]\n");
         printf("Fitness Types:\n");
         printf("     ONEMAX     : 0\n");
         printf("     MK TRAP    : 1\n");
@@ -28,9 +28,13 @@ int main(int argc, char *argv[]) {
         printf("     SPIN GLASS : 5\n");
         printf("     SAT        : 6\n");
         printf("     CUSTOM     : 7\n");
+        printf("Switches: DSMGA2_<SWITCH>=value in the environment, e.g. DSMGA2_SPARSE_K=16,\n");
+        printf("          DSMGA2_DELTA_EVAL=1 or DSMGA2_ZOBRIST_FILE=bin/zobristkey (see global.cpp)\n");
         return -1;
     }
 
+    readEnvOptions();
+
     int problemSize = atoi(argv[1]);
     int initialPopulation = atoi(argv[2]);
     int fitnessType = atoi(argv[3]);
@@ -40,6 +44,9 @@ int main(int argc, char *argv[]) {
     int display = atoi(argv[7]);
     int randomSeed = atoi(argv[8]);
 
+    if (argc == 10)
+        THREADS = atoi(argv[9]);
+
     if (fitnessType == FITNESS_NK) {
         char filename[200];
         sprintf(filename, "./NK_Instance/pnk%d_%d_%d_%d", problemSize, 4, 5, 1);
@@ -76,7 +83,11 @@ int main(int argc, char *argv[]) {
         return -1;
     }
     
-    DSMGA2 ga(problemSize, initialPopulation, maxGenerations, maxEvaluations, fitnessFunction);
+    auto batchFunction = getBatchFitnessFunction(static_cast<FitnessType>(fitnessType));
+    auto deltaFunction = getDeltaFitnessFunction(static_cast<FitnessType>(fitnessType));
+    auto neighbourFunction = getNeighbourFunction(static_cast<FitnessType>(fitnessType));
+
+    DSMGA2 ga(problemSize, initialPopulation, maxGenerations, maxEvaluations, fitnessFunction, batchFunction, deltaFunction, neighbourFunction);
 
     int usedGenerations = (display == 1) ? ga.doIt(true) : ga.doIt(false);
 
@@ -93,7 +104,14 @@ int main(int argc, char *argv[]) {
     fflush(NULL);
 
     cout << endl;
+    // NFE is hitnfe, the evaluations up to the hit, local-search ones
+    // included. The initial first-improvement climb is counted in nfe as
+    // GHC's full evaluations, with or without DSMGA2_DELTA_EVAL; the
+    // steepest-ascent climb (DSMGA2_STEEPEST_GHC) counts every flip gain
+    // it asks for in LSFE instead.
     printf("Average Generations: %f, Average NFE: %f, Average LSFE: %f, Failures: %d\n", stGen.getMean(), stFE.getMean(), stLSFE.getMean(), failCount);
+    // on stderr, so that stdout keeps the format scripts parse
+    fprintf(stderr, "Skipped back-mixing trials: %ld\n", ga.skippedTrials);
 
     if (fitnessType == FITNESS_NK) freeNKWAProblem(&nkwa);
 
@@ -0,0 +1,302 @@
+/***************************************************************************
+ *   Greedy mask growth for restricted mixing.                             *
+ ***************************************************************************/
+
+#include <algorithm>
+
+#include "global.h"
+#include "bitkernels.h"
+#include "maskgrower.h"
+
+using namespace std;
+
+
+MaskGrower::MaskGrower() {
+    dense = NULL;
+    rows = NULL;
+    sparse = NULL;
+    order = NULL;
+    ell = 0;
+    startNode = -1;
+    emitted = 0;
+    ties = false;
+    restSize = 0;
+    takenPos = -1;
+    cursor = 0;
+    last = -1;
+    head = -1;
+}
+
+void MaskGrower::start(const TriMatrix<double>& graph, const Chromosome& ch,
+                       const int* _order, int _ell, int _startNode) {
+
+    dense = &graph;
+    rows = NULL;
+    sparse = NULL;
+    order = _order;
+    ell = _ell;
+    startNode = _startNode;
+    emitted = 0;
+    ties = false;
+
+    allele.resize(ell);
+    for (int i = 0; i < ell; ++i)
+        allele[i] = (char) ch.getVal(i);
+
+    rest.resize(ell);
+    connection.resize(ell);
+    restSize = 0;
+    for (int i = 0; i < ell; ++i) {
+        int j = order[i];
+        if (j == startNode)
+            continue;
+        pair<double, double> p = graph(startNode, j);
+        rest[restSize] = j;
+        connection[restSize] = (allele[j] == allele[startNode]) ? p.first : p.second;
+        ++restSize;
+    }
+    takenPos = -1;
+}
+
+void MaskGrower::start(const LinkageRows& graph, const Chromosome& ch,
+                       const int* _order, int _ell, int _startNode) {
+
+    dense = NULL;
+    rows = &graph;
+    sparse = NULL;
+    order = _order;
+    ell = _ell;
+    startNode = _startNode;
+    emitted = 0;
+    ties = false;
+
+    allele.resize(ell);
+    for (int i = 0; i < ell; ++i)
+        allele[i] = (char) ch.getVal(i);
+
+    const int stride = graph.getStride();
+    bits.assign((stride + 63) / 64, 0ul);
+    copy(ch.getGene(), ch.getGene() + min(ch.getLengthLong(), (int) bits.size()), bits.begin());
+
+    weightRows.assign(stride, 0.0f);
+    for (int j = ell; j < stride; ++j)
+        weightRows[j] = -INFINITY;
+    weightRows[startNode] = -INFINITY;
+
+    rank.resize(ell);
+    for (int t = 0; t < ell; ++t)
+        rank[order[t]] = t;
+
+    // the list DLLA would hold: order without startNode, cyclic
+    pre.resize(ell);
+    post.resize(ell);
+    head = -1;
+    int prev = -1;
+    for (int t = 0; t < ell; ++t) {
+        int j = order[t];
+        if (j == startNode)
+            continue;
+        if (head == -1)
+            head = j;
+        else
+            post[prev] = j;
+        pre[j] = prev;
+        prev = j;
+    }
+    if (head != -1) {
+        pre[head] = prev;
+        post[prev] = head;
+    }
+
+    last = startNode;
+}
+
+void MaskGrower::start(const SparseGraph<double>& graph, const Chromosome& ch,
+                       const int* _order, int _ell, int _startNode) {
+
+    dense = NULL;
+    rows = NULL;
+    sparse = &graph;
+    order = _order;
+    ell = _ell;
+    startNode = _startNode;
+    emitted = 0;
+    ties = true;    // untouched variables all tie at 0
+
+    allele.resize(ell);
+    for (int i = 0; i < ell; ++i)
+        allele[i] = (char) ch.getVal(i);
+
+    rank.resize(ell);
+    for (int t = 0; t < ell; ++t)
+        rank[order[t]] = t;
+
+    state.assign(ell, 0);
+    weight.assign(ell, 0.0);
+    heap = priority_queue<pair<double, int> >();
+    cursor = 0;
+    state[startNode] = 2;
+    last = startNode;
+}
+
+int MaskGrower::next() {
+
+    if (emitted == 0) {
+        emitted = 1;
+        return startNode;
+    }
+    if (emitted >= ell)
+        return -1;
+
+    ++emitted;
+    if (dense != NULL)
+        return nextDense();
+    if (rows != NULL)
+        return nextRows();
+    return nextSparse();
+}
+
+// rest[] is kept in the order DLLA would iterate it, so the first
+// largest connection wins exactly as in the scan it replaces. One pass
+// drops the variable taken last time, adds its edges to the connection
+// of the others and finds the largest connection.
+int MaskGrower::nextDense() {
+
+    double max = -INF;
+    int best = -1;
+    bool tie = false;
+
+    if (takenPos < 0) {
+        for (int p = 0; p < restSize; ++p)
+            if (max < connection[p]) {
+                max = connection[p];
+                best = p;
+                tie = false;
+            } else if (connection[p] == max) {
+                tie = true;
+            }
+    } else {
+        const pair<double, double>* matrix = dense->data();
+        int node = rest[takenPos];
+        size_t rowBase = TriMatrix<double>::index(node, 0);
+        char a = allele[node];
+        int dst = 0;
+
+        auto add = [&](int src) {
+            int j = rest[src];
+            size_t k = (j < node) ? rowBase + j : TriMatrix<double>::index(j, node);
+            double c = connection[src] + ((allele[j] == a) ? matrix[k].first : matrix[k].second);
+            rest[dst] = j;
+            connection[dst] = c;
+            if (max < c) {
+                max = c;
+                best = dst;
+                tie = false;
+            } else if (c == max) {
+                tie = true;
+            }
+            ++dst;
+        };
+
+        if (takenPos == 0) {
+            // DLLA::erase moves the head back one when it erases the head
+            if (restSize > 1)
+                add(restSize - 1);
+            for (int src = 1; src < restSize - 1; ++src)
+                add(src);
+        } else {
+            for (int src = 0; src < takenPos; ++src)
+                add(src);
+            for (int src = takenPos + 1; src < restSize; ++src)
+                add(src);
+        }
+        --restSize;
+    }
+
+    ties |= tie;
+    takenPos = best;
+    return rest[best];
+}
+
+int MaskGrower::nextRows() {
+
+    const int stride = rows->getStride();
+    addByBits(&weightRows[0], rows->same(last), rows->diff(last), &bits[0], allele[last], stride);
+
+    float max = maxValue(&weightRows[0], stride);
+    int best = -1;
+    int bestRot = ell;
+    int count = 0;
+    for (int j = 0; j < ell; ++j) {
+        if (weightRows[j] != max)
+            continue;
+        ++count;
+        int rot = rank[j] - rank[head];
+        if (rot < 0) rot += ell;
+        if (rot < bestRot) {
+            best = j;
+            bestRot = rot;
+        }
+    }
+    ties |= (count > 1);
+
+    // DLLA::erase
+    post[pre[best]] = post[best];
+    pre[post[best]] = pre[best];
+    if (head == best)
+        head = pre[best];
+
+    weightRows[best] = -INFINITY;
+    last = best;
+    return best;
+}
+
+int MaskGrower::nextSparse() {
+
+    // the variable handed out last is the only one whose edges are new
+    int node = last;
+    const int* neighbour = sparse->neighbours(node);
+    const pair<double, double>* edge = sparse->edges(node);
+    for (int e = 0; e < sparse->degree(node); ++e) {
+        int j = neighbour[e];
+        if (state[j] == 2)
+            continue;
+        if (allele[j] == allele[node])//p00 or p11
+            weight[j] += edge[e].first;
+        else      //p01 or p10
+            weight[j] += edge[e].second;
+        state[j] = 1;
+        heap.push(make_pair(weight[j], -rank[j]));
+    }
+
+    while (!heap.empty()) {
+        int j = order[-heap.top().second];
+        if (state[j] != 2 && weight[j] == heap.top().first)
+            break;
+        heap.pop();
+    }
+    while (cursor < ell && state[order[cursor]] != 0)
+        ++cursor;
+
+    bool fromHeap;
+    if (heap.empty())
+        fromHeap = false;
+    else if (cursor >= ell || heap.top().first > 0.0)
+        fromHeap = true;
+    else if (heap.top().first < 0.0)
+        fromHeap = false;
+    else
+        fromHeap = (-heap.top().second < cursor);
+
+    int chosen;
+    if (fromHeap) {
+        chosen = order[-heap.top().second];
+        heap.pop();
+    } else {
+        chosen = order[cursor];
+    }
+
+    state[chosen] = 2;
+    last = chosen;
+    return chosen;
+}
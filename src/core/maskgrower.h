@@ -0,0 +1,110 @@
+/***************************************************************************
+ *   Greedy mask growth for restricted mixing.                             *
+ *                                                                         *
+ *   Starting from startNode, every step adds the remaining variable with  *
+ *   the largest summed two-edge linkage to the variables already taken    *
+ *   (00/11 edge if it agrees with them in ch, 01/10 edge otherwise).      *
+ *   next() hands the mask out one variable at a time.                     *
+ ***************************************************************************/
+
+#ifndef _MASKGROWER_H_
+#define _MASKGROWER_H_
+
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "chromosome.h"
+#include "trimatrix.h"
+#include "linkagerows.h"
+#include "sparsegraph.h"
+
+
+class MaskGrower {
+
+public:
+
+    MaskGrower();
+
+    /**
+     *  Dense graph: same result as the DLLA scan it replaces, including
+     *  ties, which go to the first variable in the list's cyclic order
+     *  (orderELL, restarted where the last erase left the head).
+     */
+    void start(const TriMatrix<double>& graph, const Chromosome& ch,
+               const int* order, int ell, int startNode);
+
+    /**
+     *  Float rows: the connections of all variables are updated at once
+     *  with addByBits. Ties go to the same variable as for the dense
+     *  graph, but the float sums themselves can differ from it.
+     */
+    void start(const LinkageRows& graph, const Chromosome& ch,
+               const int* order, int ell, int startNode);
+
+    /**
+     *  Sparse graph: variables without an edge to the mask yet have
+     *  connection 0 and are taken in order; ties go to the earlier one.
+     */
+    void start(const SparseGraph<double>& graph, const Chromosome& ch,
+               const int* order, int ell, int startNode);
+
+    /** the next variable of the mask; -1 once all of them are out */
+    int next();
+
+    /**
+     *  whether some variable handed out so far was one of several with
+     *  the largest connection, i.e. the mask depends on the order given
+     *  to start(); always true for sparse graphs
+     */
+    bool tied() const {
+        return ties;
+    }
+
+    /** number of variables handed out so far */
+    int size() const {
+        return emitted;
+    }
+
+private:
+
+    int nextDense();
+    int nextRows();
+    int nextSparse();
+
+    const TriMatrix<double>* dense;
+    const LinkageRows* rows;
+    const SparseGraph<double>* sparse;
+    const int* order;
+    int ell;
+    int startNode;
+    int emitted;
+    bool ties;
+    std::vector<char> allele;
+
+    // dense: the remaining variables in list order with their connection
+    std::vector<int> rest;
+    std::vector<double> connection;
+    int restSize;
+    int takenPos;
+
+    // rows: connection by variable, -inf once taken; the DLLA order is
+    // kept as a cyclic list only to break ties
+    std::vector<float> weightRows;
+    std::vector<unsigned long> bits;
+    std::vector<int> pre;
+    std::vector<int> post;
+    int head;
+
+    // sparse (rank is shared with rows)
+    std::vector<int> rank;
+    std::vector<char> state;    // 0: untouched, 1: in heap, 2: in mask
+    std::vector<double> weight;
+    std::priority_queue<std::pair<double, int> > heap;   // (connection, -rank)
+    int cursor;
+    int last;
+
+};
+
+
+#endif
@@ -24,6 +24,19 @@ struct Record {
     double gen;
 };
 
+// DSMGA2 on the built-in problem fitnessType, with the batch, delta and
+// neighbour functions it has; build it after the instance is loaded
+class SweepGA : public DSMGA2 {
+public:
+    SweepGA(int fitnessType, int ell, int popu)
+        : DSMGA2(ell, popu, MAX_GEN, -1,
+                 getFitnessFunction(static_cast<FitnessType>(fitnessType)),
+                 getBatchFitnessFunction(static_cast<FitnessType>(fitnessType)),
+                 getDeltaFitnessFunction(static_cast<FitnessType>(fitnessType)),
+                 getNeighbourFunction(static_cast<FitnessType>(fitnessType))) {
+    }
+};
+
 int main(int argc, char *argv[]) {
     if (argc != 4 && argc != 5 && argc != 6 && argc != 7) {
         printf("Usage: sweep <problemSize> <numConvergence> <fitnessType>\n");
@@ -40,9 +53,12 @@ int main(int argc, char *argv[]) {
         printf("     SPIN GLASS : 5\n");
         printf("     SAT        : 6\n");
         printf("     CUSTOM     : 7\n");
+        printf("Switches: DSMGA2_<SWITCH>=value in the environment (see global.cpp)\n");
         return -1;
     }
 
+    readEnvOptions();
+
     int problemSize = atoi(argv[1]);
     int numConvergence = atoi(argv[2]);
     int fitnessType = atoi(argv[3]);
@@ -121,8 +137,7 @@ int main(int argc, char *argv[]) {
         stNFE.reset();
         stLS.reset();
 
-        auto fitnessFunction = getFitnessFunction(static_cast<FitnessType>(fitnessType));
-        DSMGA2 ga(problemSize, popu, MAX_GEN, -1, fitnessFunction);
+        SweepGA ga(fitnessType, problemSize, popu);
         ga.doIt(false);
 
         stGen.record(ga.getGeneration());
@@ -173,8 +188,7 @@ int main(int argc, char *argv[]) {
         stNFE.reset();
         stLS.reset();
 
-        auto fitnessFunction = getFitnessFunction(static_cast<FitnessType>(fitnessType));
-        DSMGA2 ga(problemSize, popu, MAX_GEN, -1, fitnessFunction);
+        SweepGA ga(fitnessType, problemSize, popu);
         ga.doIt(false);
 
         stGen.record(ga.getGeneration());
@@ -223,8 +237,7 @@ int main(int argc, char *argv[]) {
         stNFE.reset();
         stLS.reset();
 
-        auto fitnessFunction = getFitnessFunction(static_cast<FitnessType>(fitnessType));
-        DSMGA2 ga(problemSize, popu, MAX_GEN, -1, fitnessFunction);
+        SweepGA ga(fitnessType, problemSize, popu);
         ga.doIt(false);
 
         stGen.record(ga.getGeneration());
@@ -275,10 +288,7 @@ int main(int argc, char *argv[]) {
         foundOptima = true;
 
         for (int j=0; j<numConvergence; j++) {
-            // Get fitness function
-            auto fitnessFunction = getFitnessFunction(static_cast<FitnessType>(fitnessType));
-            
-            DSMGA2 ga(problemSize, q1.n, MAX_GEN, -1, fitnessFunction);
+            SweepGA ga(fitnessType, problemSize, q1.n);
             if (!ga.foundOptima()) {
                 foundOptima = false;
                 if (SHOW_BISECTION) {
@@ -318,10 +328,7 @@ int main(int argc, char *argv[]) {
         foundOptima = true;
 
         for (int j=0; j<numConvergence; j++) {
-            // Get fitness function
-            auto fitnessFunction = getFitnessFunction(static_cast<FitnessType>(fitnessType));
-            
-            DSMGA2 ga(problemSize, q3.n, MAX_GEN, -1, fitnessFunction);
+            SweepGA ga(fitnessType, problemSize, q3.n);
             if (!ga.foundOptima()) {
                 foundOptima = false;
                 if (SHOW_BISECTION) {
@@ -1,4 +1,7 @@
 #include "fitness_functions.h"
+#include <algorithm>
+#include <vector>
+#include "bitkernels.h"
 
 double trap(int unitary, double fHigh, double fLow, int trapK) {
     if (unitary > trapK)
@@ -10,6 +13,34 @@ double trap(int unitary, double fHigh, double fLow, int trapK) {
         return fLow - unitary * fLow / (trapK-1);
 }
 
+static double fTrap(int u) {
+    if (u == 0 || u == 6)
+        return 1.0;
+    else if (u == 1 || u == 5)
+        return 0.0;
+    else if (u == 2 || u == 4)
+        return 0.4;
+    else // u == 3
+        return 0.8;
+}
+
+// the k <= 64 bits starting at start, as the low bits of a word
+static inline unsigned long extractBits(const unsigned long* gene, int start, int k) {
+    int q = quotientLong(start);
+    int r = remainderLong(start);
+    unsigned long w = gene[q] >> r;
+    if (r + k > 64)
+        w |= gene[q + 1] << (64 - r);
+    if (k < 64)
+        w &= (1lu << k) - 1;
+    return w;
+}
+
+// number of ones among the k <= 64 bits starting at start
+static inline int countBits(const unsigned long* gene, int start, int k) {
+    return __builtin_popcountl(extractBits(gene, start, k));
+}
+
 double oneMaxFitness(const Chromosome& ch) {
     double result = 0;
     for (int i = 0; i < ch.getLength(); ++i)
@@ -38,14 +69,7 @@ double fTrapFitness(const Chromosome& ch) {
         for (int j = 0; j < 6; ++j)
             u += ch.getVal(i*6+j);
 
-        if (u == 0 || u == 6)
-            result += 1.0;
-        else if (u == 1 || u == 5)
-            result += 0.0;
-        else if (u == 2 || u == 4)
-            result += 0.4;
-        else // u == 3
-            result += 0.8;
+        result += fTrap(u);
     }
     return result;
 }
@@ -101,6 +125,433 @@ double satFitness(const Chromosome& ch) {
     return result;
 }
 
+POPCNT_CLONES
+void oneMaxBatch(const Chromosome* const* chs, int n, double* fitness) {
+    for (int k = 0; k < n; ++k) {
+        const unsigned long* gene = chs[k]->getGene();
+        int length = chs[k]->getLength();
+        int full = quotientLong(length);
+        int ones = 0;
+        for (int q = 0; q < full; ++q)
+            ones += __builtin_popcountl(gene[q]);
+        if (remainderLong(length) != 0)
+            ones += countBits(gene, full * 64, remainderLong(length));
+        fitness[k] = ones;
+    }
+}
+
+POPCNT_CLONES
+void mkTrapBatch(const Chromosome* const* chs, int n, double* fitness) {
+    for (int k = 0; k < n; ++k) {
+        const unsigned long* gene = chs[k]->getGene();
+        int TRAP_M = chs[k]->getLength() / TRAP_K;
+        double result = 0;
+        for (int i = 0; i < TRAP_M; i++)
+            result += trap(countBits(gene, i * TRAP_K, TRAP_K), 1.0, 0.8, TRAP_K);
+        fitness[k] = result;
+    }
+}
+
+POPCNT_CLONES
+void fTrapBatch(const Chromosome* const* chs, int n, double* fitness) {
+    for (int k = 0; k < n; ++k) {
+        const unsigned long* gene = chs[k]->getGene();
+        double result = 0.0;
+        for (int i = 0; i < chs[k]->getLength()/6; ++i)
+            result += fTrap(countBits(gene, i*6, 6));
+        fitness[k] = result;
+    }
+}
+
+POPCNT_CLONES
+void cycTrapBatch(const Chromosome* const* chs, int n, double* fitness) {
+    for (int k = 0; k < n; ++k) {
+        const unsigned long* gene = chs[k]->getGene();
+        int length = chs[k]->getLength();
+        int TRAP_M = length / (TRAP_K-1);
+        double result = 0;
+        for (int i = 0; i < TRAP_M; i++) {
+            int idx = i * TRAP_K - i;
+            int u;
+            if (idx + TRAP_K <= length)
+                u = countBits(gene, idx, TRAP_K);
+            else    // the last trap wraps around to the front
+                u = countBits(gene, idx, length - idx) + countBits(gene, 0, idx + TRAP_K - length);
+            result += trap(u, 1.0, 0.8, TRAP_K);
+        }
+        fitness[k] = result;
+    }
+}
+
+// Not batch kernels: the per-individual loop a custom function gets,
+// over the same evaluate*() calls as the scalar functions, so that every
+// built-in type has a BatchFunction. They only share the buffer.
+
+void nkBatch(const Chromosome* const* chs, int n, double* fitness) {
+    std::vector<char> x;
+    for (int k = 0; k < n; ++k) {
+        x.resize(chs[k]->getLength());
+        for (int i = 0; i < chs[k]->getLength(); ++i)
+            x[i] = (char)chs[k]->getVal(i);
+        fitness[k] = evaluateNKProblem(x.data(), &nkwa);
+    }
+}
+
+void spinGlassBatch(const Chromosome* const* chs, int n, double* fitness) {
+    std::vector<int> x;
+    for (int k = 0; k < n; ++k) {
+        x.resize(chs[k]->getLength());
+        for (int i = 0; i < chs[k]->getLength(); i++)
+            x[i] = chs[k]->getVal(i) == 1 ? 1 : -1;
+        fitness[k] = evaluateSPIN(x.data(), &mySpinGlassParams);
+    }
+}
+
+void satBatch(const Chromosome* const* chs, int n, double* fitness) {
+    std::vector<int> x;
+    for (int k = 0; k < n; ++k) {
+        x.resize(chs[k]->getLength());
+        for (int i = 0; i < chs[k]->getLength(); ++i)
+            x[i] = chs[k]->getVal(i);
+        fitness[k] = evaluateSAT(x.data(), &mySAT);
+    }
+}
+
+// Fitness changes. Each problem is a sum of subfunctions; only those a
+// flipped bit falls in are looked at, once each, with all of their
+// flipped bits applied together.
+
+// (subfunction, its flipped bits) with one entry per subfunction
+typedef std::pair<int, unsigned long> BlockFlip;
+
+static void mergeBlockFlips(std::vector<BlockFlip>& flips) {
+    std::sort(flips.begin(), flips.end());
+    size_t out = 0;
+    for (size_t k = 0; k < flips.size(); ++k) {
+        if (out > 0 && flips[out - 1].first == flips[k].first)
+            flips[out - 1].second ^= flips[k].second;
+        else
+            flips[out++] = flips[k];
+    }
+    flips.resize(out);
+}
+
+// Traps: block i covers size bits from i * step on, wrapping around to
+// the front; bit j of a block word is its j-th position.
+static unsigned long blockBits(const unsigned long* gene, int length, int start, int size) {
+    if (start + size <= length)
+        return extractBits(gene, start, size);
+    int head = length - start;
+    return extractBits(gene, start, head) | (extractBits(gene, 0, size - head) << head);
+}
+
+template<class Value>
+POPCNT_CLONES
+static double trapDelta(const Chromosome& ch, const int* bits, int n,
+                        int size, int step, int nBlocks, Value value) {
+    const int length = ch.getLength();
+    static thread_local std::vector<BlockFlip> flips;
+    flips.clear();
+    for (int k = 0; k < n; ++k) {
+        int b = bits[k];
+        int lo = (b - size + 1 <= 0) ? 0 : (b - size + step) / step;
+        int hi = std::min(b / step, nBlocks - 1);
+        for (int i = lo; i <= hi; ++i)
+            if (b < i * step + size)
+                flips.push_back(BlockFlip(i, 1lu << (b - i * step)));
+        for (int i = nBlocks - 1; i >= 0 && i * step + size > length; --i)
+            if (b < i * step + size - length)
+                flips.push_back(BlockFlip(i, 1lu << (length - i * step + b)));
+    }
+    mergeBlockFlips(flips);
+
+    double delta = 0.0;
+    for (size_t k = 0; k < flips.size(); ++k) {
+        unsigned long w = blockBits(ch.getGene(), length, flips[k].first * step, size);
+        delta += value(__builtin_popcountl(w ^ flips[k].second)) - value(__builtin_popcountl(w));
+    }
+    return delta;
+}
+
+double oneMaxDelta(const Chromosome& ch, const int* bits, int n) {
+    double delta = 0.0;
+    for (int k = 0; k < n; ++k)
+        delta += (ch.getVal(bits[k]) == 1) ? -1.0 : 1.0;
+    return delta;
+}
+
+double mkTrapDelta(const Chromosome& ch, const int* bits, int n) {
+    return trapDelta(ch, bits, n, TRAP_K, TRAP_K, ch.getLength() / TRAP_K,
+                     [](int u) { return trap(u, 1.0, 0.8, TRAP_K); });
+}
+
+double fTrapDelta(const Chromosome& ch, const int* bits, int n) {
+    return trapDelta(ch, bits, n, 6, 6, ch.getLength() / 6, fTrap);
+}
+
+double cycTrapDelta(const Chromosome& ch, const int* bits, int n) {
+    return trapDelta(ch, bits, n, TRAP_K, TRAP_K - 1, ch.getLength() / (TRAP_K - 1),
+                     [](int u) { return trap(u, 1.0, 0.8, TRAP_K); });
+}
+
+// NK as evaluateNKProblem reads it: block which covers positions
+// which * step on, cut short at the end; position p holds variable pi[p]
+// and is bit size - 1 - (p - which * step) of the table index.
+// nkPosition[v] is the position of variable v, built by prepareIndexes.
+static const int* nkPi = NULL;
+static std::vector<int> nkPosition;
+
+static void buildNKPositions(const NKWAProblem* problem) {
+    if (nkPi == problem->pi && (int) nkPosition.size() == problem->n)
+        return;
+    nkPi = problem->pi;
+    nkPosition.assign(problem->n, 0);
+    for (int p = 0; p < problem->n; ++p)
+        nkPosition[problem->pi[p]] = p;
+}
+
+static inline int nkBlockSize(const NKWAProblem* problem, int which) {
+    int j = which * problem->step;
+    return (j > problem->n - problem->k) ? problem->n - j : problem->k;
+}
+
+double nkDelta(const Chromosome& ch, const int* bits, int n) {
+    const NKWAProblem* problem = &nkwa;
+    const int* position = nkPosition.data();
+    const int m = (problem->n + problem->step - 1) / problem->step;
+
+    static thread_local std::vector<BlockFlip> flips;
+    flips.clear();
+    for (int k = 0; k < n; ++k) {
+        int p = position[bits[k]];
+        int lo = (p - problem->k + 1 <= 0) ? 0 : (p - problem->k + problem->step) / problem->step;
+        int hi = std::min(p / problem->step, m - 1);
+        for (int which = lo; which <= hi; ++which) {
+            int size = nkBlockSize(problem, which);
+            int offset = p - which * problem->step;
+            if (offset < size)
+                flips.push_back(BlockFlip(which, 1lu << (size - 1 - offset)));
+        }
+    }
+    mergeBlockFlips(flips);
+
+    double delta = 0.0;
+    for (size_t k = 0; k < flips.size(); ++k) {
+        int which = flips[k].first;
+        int j = which * problem->step;
+        int size = nkBlockSize(problem, which);
+        int num = 0;
+        for (int i = 0; i < size; i++)
+            num = (num << 1) + ch.getVal(problem->pi[j + i]);
+        delta += problem->c[which][num ^ (int) flips[k].second] - problem->c[which][num];
+    }
+    return delta;
+}
+
+// Spin glass and SAT: the terms every variable appears in, built once
+// per instance by prepareIndexes.
+struct TermIndex {
+    const void* instance;
+    const int* data;
+    size_t size;
+    std::vector<int> start;     // terms of variable v: term[start[v] .. start[v + 1])
+    std::vector<int> term;
+};
+
+template<class Build>
+static void buildTermIndex(TermIndex& index, const void* instance,
+                           const std::vector<int>& fvector, Build build) {
+    if (index.instance != instance || index.data != fvector.data() || index.size != fvector.size()) {
+        index.instance = instance;
+        index.data = fvector.data();
+        index.size = fvector.size();
+        build(index);
+    }
+}
+
+static TermIndex spinEdges;
+static TermIndex satClauses;
+
+static bool isFlipped(const std::vector<int>& sorted, int v) {
+    return std::binary_search(sorted.begin(), sorted.end(), v);
+}
+
+// fvector holds (i, j, J) per coupling, 1-based
+static void buildSpinEdges() {
+    const SPINinstance* inst = &mySpinGlassParams;
+    const std::vector<int>& f = inst->fvector;
+    buildTermIndex(spinEdges, inst, f, [&](TermIndex& t) {
+        std::vector<int> degree(inst->ell + 1, 0);
+        for (size_t e = 0; e + 2 < f.size(); e += 3) {
+            degree[f[e] - 1]++;
+            degree[f[e + 1] - 1]++;
+        }
+        t.start.assign(inst->ell + 1, 0);
+        for (int v = 0; v < inst->ell; ++v)
+            t.start[v + 1] = t.start[v] + degree[v];
+        t.term.assign(t.start[inst->ell], 0);
+        std::vector<int> fill(t.start.begin(), t.start.end() - 1);
+        for (size_t e = 0; e + 2 < f.size(); e += 3) {
+            t.term[fill[f[e] - 1]++] = (int) e;
+            t.term[fill[f[e + 1] - 1]++] = (int) e;
+        }
+    });
+}
+
+double spinGlassDelta(const Chromosome& ch, const int* bits, int n) {
+    const SPINinstance* inst = &mySpinGlassParams;
+    const std::vector<int>& f = inst->fvector;
+    const TermIndex& edges = spinEdges;
+
+    static thread_local std::vector<int> flipped;
+    flipped.assign(bits, bits + n);
+    std::sort(flipped.begin(), flipped.end());
+
+    long change = 0;
+    for (int k = 0; k < n; ++k) {
+        int v = bits[k];
+        for (int t = edges.start[v]; t < edges.start[v + 1]; ++t) {
+            int e = edges.term[t];
+            int a = f[e] - 1;
+            int b = f[e + 1] - 1;
+            int other = (a == v) ? b : a;
+            if (other == v || isFlipped(flipped, other))
+                continue;   // both ends flip: the product stays
+            int xa = ch.getVal(a) == 1 ? 1 : -1;
+            int xb = ch.getVal(b) == 1 ? 1 : -1;
+            change -= 2 * xa * xb * f[e + 2];
+        }
+    }
+    return change / (double) inst->ell;
+}
+
+// fvector holds every clause's literals followed by 0
+static void buildSatClauses() {
+    const SATinstance* inst = &mySAT;
+    const std::vector<int>& f = inst->fvector;
+    buildTermIndex(satClauses, inst, f, [&](TermIndex& t) {
+        std::vector<std::vector<int> > of(inst->var);
+        size_t begin = 0;
+        for (size_t e = 0; e < f.size(); ++e) {
+            if (f[e] != 0)
+                continue;
+            for (size_t l = begin; l < e; ++l) {
+                int v = (f[l] > 0) ? f[l] - 1 : -f[l] - 1;
+                if (of[v].empty() || of[v].back() != (int) begin)
+                    of[v].push_back((int) begin);
+            }
+            begin = e + 1;
+        }
+        t.start.assign(inst->var + 1, 0);
+        t.term.clear();
+        for (int v = 0; v < inst->var; ++v) {
+            t.term.insert(t.term.end(), of[v].begin(), of[v].end());
+            t.start[v + 1] = (int) t.term.size();
+        }
+    });
+}
+
+double satDelta(const Chromosome& ch, const int* bits, int n) {
+    const std::vector<int>& f = mySAT.fvector;
+    const TermIndex& clauses = satClauses;
+
+    static thread_local std::vector<int> flipped;
+    flipped.assign(bits, bits + n);
+    std::sort(flipped.begin(), flipped.end());
+
+    static thread_local std::vector<int> touched;
+    touched.clear();
+    for (int k = 0; k < n; ++k)
+        touched.insert(touched.end(), clauses.term.begin() + clauses.start[bits[k]],
+                       clauses.term.begin() + clauses.start[bits[k] + 1]);
+    std::sort(touched.begin(), touched.end());
+    touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+
+    double delta = 0.0;
+    for (size_t c = 0; c < touched.size(); ++c) {
+        bool before = false, after = false;
+        for (size_t l = touched[c]; f[l] != 0; ++l) {
+            int v = (f[l] > 0) ? f[l] - 1 : -f[l] - 1;
+            int x = ch.getVal(v);
+            bool lit = (f[l] > 0) ? (x == 1) : (x == 0);
+            before |= lit;
+            after |= (lit != isFlipped(flipped, v));
+        }
+        delta += (double) before - (double) after;
+    }
+    return -delta;
+}
+
+// Neighbours: the variables sharing a subfunction with i (i itself and
+// repeats left out), for local search to know which flip gains change
+// when i flips.
+
+static void addNeighbour(int i, int v, std::vector<int>& out) {
+    if (v != i && std::find(out.begin(), out.end(), v) == out.end())
+        out.push_back(v);
+}
+
+static void trapNeighbours(int length, int i, int size, int step, int nBlocks, std::vector<int>& out) {
+    int lo = (i - size + 1 <= 0) ? 0 : (i - size + step) / step;
+    int hi = std::min(i / step, nBlocks - 1);
+    for (int b = lo; b <= hi; ++b)
+        if (i < b * step + size)
+            for (int j = 0; j < size; ++j)
+                addNeighbour(i, (b * step + j) % length, out);
+    for (int b = nBlocks - 1; b >= 0 && b * step + size > length; --b)
+        if (i < b * step + size - length)
+            for (int j = 0; j < size; ++j)
+                addNeighbour(i, (b * step + j) % length, out);
+}
+
+void oneMaxNeighbours(int, int, std::vector<int>&) {
+}
+
+void mkTrapNeighbours(int length, int i, std::vector<int>& out) {
+    trapNeighbours(length, i, TRAP_K, TRAP_K, length / TRAP_K, out);
+}
+
+void fTrapNeighbours(int length, int i, std::vector<int>& out) {
+    trapNeighbours(length, i, 6, 6, length / 6, out);
+}
+
+void cycTrapNeighbours(int length, int i, std::vector<int>& out) {
+    trapNeighbours(length, i, TRAP_K, TRAP_K - 1, length / (TRAP_K - 1), out);
+}
+
+void nkNeighbours(int, int i, std::vector<int>& out) {
+    const NKWAProblem* problem = &nkwa;
+    int p = nkPosition[i];
+    int m = (problem->n + problem->step - 1) / problem->step;
+    int lo = (p - problem->k + 1 <= 0) ? 0 : (p - problem->k + problem->step) / problem->step;
+    int hi = std::min(p / problem->step, m - 1);
+    for (int which = lo; which <= hi; ++which) {
+        int j = which * problem->step;
+        int size = nkBlockSize(problem, which);
+        if (p - j < size)
+            for (int o = 0; o < size; ++o)
+                addNeighbour(i, problem->pi[j + o], out);
+    }
+}
+
+void spinGlassNeighbours(int, int i, std::vector<int>& out) {
+    const std::vector<int>& f = mySpinGlassParams.fvector;
+    const TermIndex& edges = spinEdges;
+    for (int t = edges.start[i]; t < edges.start[i + 1]; ++t) {
+        int e = edges.term[t];
+        addNeighbour(i, f[e] - 1, out);
+        addNeighbour(i, f[e + 1] - 1, out);
+    }
+}
+
+void satNeighbours(int, int i, std::vector<int>& out) {
+    const std::vector<int>& f = mySAT.fvector;
+    const TermIndex& clauses = satClauses;
+    for (int t = clauses.start[i]; t < clauses.start[i + 1]; ++t)
+        for (size_t l = clauses.term[t]; f[l] != 0; ++l)
+            addNeighbour(i, (f[l] > 0) ? f[l] - 1 : -f[l] - 1, out);
+}
+
 std::function<double(const Chromosome&)> getFitnessFunction(FitnessType type) {
     switch (type) {
         case FITNESS_ONEMAX:
@@ -122,4 +573,88 @@ std::function<double(const Chromosome&)> getFitnessFunction(FitnessType type) {
         default:
             return nullptr;
     }
-} 
\ No newline at end of file
+}
+
+Chromosome::BatchFunction getBatchFitnessFunction(FitnessType type) {
+    switch (type) {
+        case FITNESS_ONEMAX:
+            return oneMaxBatch;
+        case FITNESS_MKTRAP:
+            return mkTrapBatch;
+        case FITNESS_FTRAP:
+            return fTrapBatch;
+        case FITNESS_CYCTRAP:
+            return cycTrapBatch;
+        case FITNESS_NK:
+            return nkBatch;
+        case FITNESS_SPINGLASS:
+            return spinGlassBatch;
+        case FITNESS_SAT:
+            return satBatch;
+        default:
+            return nullptr;
+    }
+}
+
+// The indexes the delta and neighbour functions read, for the instance
+// loaded now. Built here, before any run, so that the functions
+// themselves only read them and need no lock.
+static void prepareIndexes(FitnessType type) {
+    switch (type) {
+        case FITNESS_NK:
+            buildNKPositions(&nkwa);
+            break;
+        case FITNESS_SPINGLASS:
+            buildSpinEdges();
+            break;
+        case FITNESS_SAT:
+            buildSatClauses();
+            break;
+        default:
+            break;
+    }
+}
+
+Chromosome::DeltaFunction getDeltaFitnessFunction(FitnessType type) {
+    prepareIndexes(type);
+    switch (type) {
+        case FITNESS_ONEMAX:
+            return oneMaxDelta;
+        case FITNESS_MKTRAP:
+            return mkTrapDelta;
+        case FITNESS_FTRAP:
+            return fTrapDelta;
+        case FITNESS_CYCTRAP:
+            return cycTrapDelta;
+        case FITNESS_NK:
+            return nkDelta;
+        case FITNESS_SPINGLASS:
+            return spinGlassDelta;
+        case FITNESS_SAT:
+            return satDelta;
+        default:
+            return nullptr;
+    }
+}
+
+Chromosome::NeighbourFunction getNeighbourFunction(FitnessType type) {
+    prepareIndexes(type);
+    switch (type) {
+        case FITNESS_ONEMAX:
+            return oneMaxNeighbours;
+        case FITNESS_MKTRAP:
+            return mkTrapNeighbours;
+        case FITNESS_FTRAP:
+            return fTrapNeighbours;
+        case FITNESS_CYCTRAP:
+            return cycTrapNeighbours;
+        case FITNESS_NK:
+            return nkNeighbours;
+        case FITNESS_SPINGLASS:
+            return spinGlassNeighbours;
+        case FITNESS_SAT:
+            return satNeighbours;
+        default:
+            return nullptr;
+    }
+}
@@ -6,6 +6,7 @@
 #include "nk-wa.h"
 #include "sat.h"
 #include <functional>
+#include <vector>
 
 #define TRAP_K 5
 
@@ -33,7 +34,47 @@ double nkFitness(const Chromosome& ch);
 double spinGlassFitness(const Chromosome& ch);
 double satFitness(const Chromosome& ch);
 
+// Batch versions: same values. OneMax and the traps read the gene words
+// directly; NK, spin glass and SAT loop over the scalar evaluation.
+void oneMaxBatch(const Chromosome* const* chs, int n, double* fitness);
+void mkTrapBatch(const Chromosome* const* chs, int n, double* fitness);
+void fTrapBatch(const Chromosome* const* chs, int n, double* fitness);
+void cycTrapBatch(const Chromosome* const* chs, int n, double* fitness);
+void nkBatch(const Chromosome* const* chs, int n, double* fitness);
+void spinGlassBatch(const Chromosome* const* chs, int n, double* fitness);
+void satBatch(const Chromosome* const* chs, int n, double* fitness);
+
+// Fitness change if the given bits of ch flipped; only the subfunctions
+// those bits fall in are evaluated
+double oneMaxDelta(const Chromosome& ch, const int* bits, int n);
+double mkTrapDelta(const Chromosome& ch, const int* bits, int n);
+double fTrapDelta(const Chromosome& ch, const int* bits, int n);
+double cycTrapDelta(const Chromosome& ch, const int* bits, int n);
+double nkDelta(const Chromosome& ch, const int* bits, int n);
+double spinGlassDelta(const Chromosome& ch, const int* bits, int n);
+double satDelta(const Chromosome& ch, const int* bits, int n);
+
+// Variables sharing a subfunction with i, appended to out
+void oneMaxNeighbours(int length, int i, std::vector<int>& out);
+void mkTrapNeighbours(int length, int i, std::vector<int>& out);
+void fTrapNeighbours(int length, int i, std::vector<int>& out);
+void cycTrapNeighbours(int length, int i, std::vector<int>& out);
+void nkNeighbours(int length, int i, std::vector<int>& out);
+void spinGlassNeighbours(int length, int i, std::vector<int>& out);
+void satNeighbours(int length, int i, std::vector<int>& out);
+
 // Function to get appropriate fitness function based on type
 std::function<double(const Chromosome&)> getFitnessFunction(FitnessType type);
 
+// Batch function for a built-in type; nullptr for FITNESS_CUSTOM
+Chromosome::BatchFunction getBatchFitnessFunction(FitnessType type);
+
+// Delta function for a built-in type; nullptr for FITNESS_CUSTOM.
+// Call it after the instance is loaded: it indexes the instance.
+Chromosome::DeltaFunction getDeltaFitnessFunction(FitnessType type);
+
+// Neighbour function for a built-in type; nullptr for FITNESS_CUSTOM.
+// Call it after the instance is loaded, as getDeltaFitnessFunction.
+Chromosome::NeighbourFunction getNeighbourFunction(FitnessType type);
+
 #endif 
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "dsmga2.h"
 #include "chromosome.h"
 #include "fitness_functions.h"
+#include "global.h"
 
 namespace py = pybind11;
 
@@ -14,9 +15,63 @@ private:
     int maxGenerations;
     int maxEvaluations;
     std::function<double(const std::vector<int>&)> customObjectiveFunction;
+    std::function<std::vector<double>(const std::vector<std::vector<int>>&)> customBatchObjectiveFunction;
     FitnessType fitnessType;
     bool useCustomFunction;
 
+    static std::vector<int> toVector(const Chromosome& ch, int n) {
+        std::vector<int> x(n);
+        for (int i = 0; i < n; i++) {
+            x[i] = ch.getVal(i);
+        }
+        return x;
+    }
+
+    std::function<double(const Chromosome&)> fitnessFunction() {
+        if (!useCustomFunction)
+            return getFitnessFunction(fitnessType);
+        if (customObjectiveFunction) {
+            return [this](const Chromosome& ch) {
+                return this->customObjectiveFunction(toVector(ch, problemSize));
+            };
+        }
+        if (customBatchObjectiveFunction) {
+            return [this](const Chromosome& ch) {
+                return this->customBatchObjectiveFunction({toVector(ch, problemSize)}).at(0);
+            };
+        }
+        throw std::runtime_error("Custom objective function not set");
+    }
+
+    // one Python call per batch when a batch objective is set; back mixing
+    // then sends its trials as batches even on one thread
+    Chromosome::BatchFunction batchFunction() {
+        Chromosome::batchPreferred = useCustomFunction && customBatchObjectiveFunction;
+        if (!useCustomFunction)
+            return getBatchFitnessFunction(fitnessType);
+        if (!customBatchObjectiveFunction)
+            return nullptr;
+        return [this](const Chromosome* const* chs, int n, double* fitness) {
+            std::vector<std::vector<int>> xs(n);
+            for (int k = 0; k < n; k++) {
+                xs[k] = toVector(*chs[k], problemSize);
+            }
+            std::vector<double> f = this->customBatchObjectiveFunction(xs);
+            if ((int) f.size() != n) {
+                throw std::runtime_error("Batch objective function returned a wrong number of values");
+            }
+            std::copy(f.begin(), f.end(), fitness);
+        };
+    }
+
+    // Runs ga without the GIL. A Python objective takes it back on every
+    // call, so the pool workers can call it under PARALLEL_BACKMIXING;
+    // holding it here while they wait on the pool would deadlock.
+    static int run(DSMGA2& ga) {
+        py::gil_scoped_release release;
+        return ga.doIt(false);
+    }
+
 public:
     PyOptimizer(int problem_size, 
                 int population_size = 100,
@@ -58,47 +113,31 @@ public:
         customObjectiveFunction = func;
     }
 
-    std::pair<std::vector<int>, double> optimize() {
-        std::function<double(const Chromosome&)> fitnessFunc;
-        
-        if (useCustomFunction) {
-            if (!customObjectiveFunction) {
-                throw std::runtime_error("Custom objective function not set");
-            }
-            fitnessFunc = [this](const Chromosome& ch) {
-                std::vector<int> x(problemSize);
-                for (int i = 0; i < problemSize; i++) {
-                    x[i] = ch.getVal(i);
-                }
-                return this->customObjectiveFunction(x);
-            };
-        } else {
-            fitnessFunc = getFitnessFunction(fitnessType);
+    void set_batch_objective_function(const std::function<std::vector<double>(const std::vector<std::vector<int>>&)>& func) {
+        if (!useCustomFunction) {
+            throw std::runtime_error("Cannot set objective function when using predefined fitness type");
         }
+        customBatchObjectiveFunction = func;
+    }
+
+    std::pair<std::vector<int>, double> optimize() {
+        std::function<double(const Chromosome&)> fitnessFunc = fitnessFunction();
+        Chromosome::BatchFunction batchFunc = batchFunction();
+        Chromosome::DeltaFunction deltaFunc = useCustomFunction ? nullptr : getDeltaFitnessFunction(fitnessType);
+        Chromosome::NeighbourFunction neighbourFunc = useCustomFunction ? nullptr : getNeighbourFunction(fitnessType);
 
-        DSMGA2 ga(problemSize, populationSize, maxGenerations, maxEvaluations, fitnessFunc);
-        ga.doIt(false);
+        DSMGA2 ga(problemSize, populationSize, maxGenerations, maxEvaluations, fitnessFunc, batchFunc, deltaFunc, neighbourFunc);
+        run(ga);
 
         return {ga.getBest(), ga.getBestFitness()};
     }
 
     // Add sweep member function
     py::dict sweep(int min_pop = 10, int max_pop = 200, int step_size = 30) {
-        std::function<double(const Chromosome&)> fitnessFunc;
-        if (useCustomFunction) {
-            if (!customObjectiveFunction) {
-                throw std::runtime_error("Custom objective function not set");
-            }
-            fitnessFunc = [this](const Chromosome& ch) {
-                std::vector<int> x(problemSize);
-                for (int i = 0; i < problemSize; i++) {
-                    x[i] = ch.getVal(i);
-                }
-                return this->customObjectiveFunction(x);
-            };
-        } else {
-            fitnessFunc = getFitnessFunction(fitnessType);
-        }
+        std::function<double(const Chromosome&)> fitnessFunc = fitnessFunction();
+        Chromosome::BatchFunction batchFunc = batchFunction();
+        Chromosome::DeltaFunction deltaFunc = useCustomFunction ? nullptr : getDeltaFitnessFunction(fitnessType);
+        Chromosome::NeighbourFunction neighbourFunc = useCustomFunction ? nullptr : getNeighbourFunction(fitnessType);
 
         auto start_time = std::chrono::steady_clock::now();
 
@@ -116,8 +155,8 @@ public:
 
         // Phase 1: Initial evaluation of three population sizes
         for (int i = 0; i < 3; ++i) {
-            DSMGA2 ga(problemSize, rec[i].n, maxGenerations, maxEvaluations, fitnessFunc);
-            int gens = ga.doIt(false);
+            DSMGA2 ga(problemSize, rec[i].n, maxGenerations, maxEvaluations, fitnessFunc, batchFunc, deltaFunc, neighbourFunc);
+            int gens = run(ga);
             rec[i].gen = gens;
             rec[i].nfe = Chromosome::hitnfe;
         }
@@ -128,8 +167,8 @@ public:
             rec[1].n = (rec[0].n + rec[2].n) / 2;
             step_size /= 2;
 
-            DSMGA2 ga(problemSize, rec[1].n, maxGenerations, maxEvaluations, fitnessFunc);
-            int gens = ga.doIt(false);
+            DSMGA2 ga(problemSize, rec[1].n, maxGenerations, maxEvaluations, fitnessFunc, batchFunc, deltaFunc, neighbourFunc);
+            int gens = run(ga);
             rec[1].gen = gens;
             rec[1].nfe = Chromosome::hitnfe;
         }
@@ -138,8 +177,8 @@ public:
         while ((rec[1].nfe >= rec[0].nfe) || (rec[1].nfe >= rec[2].nfe)) {
             int popu = rec[2].n + step_size;
             
-            DSMGA2 ga(problemSize, popu, maxGenerations, maxEvaluations, fitnessFunc);
-            int gens = ga.doIt(false);
+            DSMGA2 ga(problemSize, popu, maxGenerations, maxEvaluations, fitnessFunc, batchFunc, deltaFunc, neighbourFunc);
+            int gens = run(ga);
 
             rec[0] = rec[1];
             rec[1] = rec[2];
@@ -159,13 +198,13 @@ public:
             q3.n = (rec[1].n + rec[2].n) / 2;
 
             // Evaluate q1
-            DSMGA2 ga1(problemSize, q1.n, maxGenerations, maxEvaluations, fitnessFunc);
-            q1.gen = ga1.doIt(false);
+            DSMGA2 ga1(problemSize, q1.n, maxGenerations, maxEvaluations, fitnessFunc, batchFunc, deltaFunc, neighbourFunc);
+            q1.gen = run(ga1);
             q1.nfe = Chromosome::hitnfe;
 
             // Evaluate q3
-            DSMGA2 ga3(problemSize, q3.n, maxGenerations, maxEvaluations, fitnessFunc);
-            q3.gen = ga3.doIt(false);
+            DSMGA2 ga3(problemSize, q3.n, maxGenerations, maxEvaluations, fitnessFunc, batchFunc, deltaFunc, neighbourFunc);
+            q3.gen = run(ga3);
             q3.nfe = Chromosome::hitnfe;
 
             // Update records based on best result
@@ -306,9 +345,19 @@ py::object sweep_dsmga2(const std::function<double(const std::vector<double>&)>&
     return result;
 }
 
+// owns the path ZOBRIST_FILE points to
+static std::string zobristFile;
+
+void set_zobrist_file(const std::string& filename) {
+    zobristFile = filename;
+    ZOBRIST_FILE = zobristFile.empty() ? NULL : zobristFile.c_str();
+}
+
 PYBIND11_MODULE(dsmga2, m) {
     m.doc() = "DSMGA-II optimization algorithm with scipy.optimize-like interface";
 
+    readEnvOptions();
+
     py::class_<PyOptimizer>(m, "DSMGA2")
         .def(py::init<int, int, int, int, const std::string&>(),
              py::arg("problem_size"),
@@ -318,6 +367,8 @@ PYBIND11_MODULE(dsmga2, m) {
              py::arg("fitness_type") = "custom")
         .def("set_objective_function", &PyOptimizer::set_objective_function,
              "Set the custom objective function")
+        .def("set_batch_objective_function", &PyOptimizer::set_batch_objective_function,
+             "Set a custom objective function taking a list of solutions and returning their fitnesses")
         .def("optimize", &PyOptimizer::optimize,
              "Run the optimization and return (best_solution, best_fitness)")
         .def("sweep", &PyOptimizer::sweep,
@@ -331,4 +382,34 @@ PYBIND11_MODULE(dsmga2, m) {
     
     m.def("sweep", &sweep_dsmga2,
           "Find optimal parameters for DSMGA2");
+
+    // mode switches; each applies to the runs started after it is set
+    m.def("set_threads", [](int n) { THREADS = n; }, py::arg("n"),
+          "Worker threads for model building");
+    m.def("set_mask_cache", [](bool on) { MASK_CACHE = on; }, py::arg("on"),
+          "Reuse restricted-mixing masks within a generation");
+    m.def("set_incremental", [](bool on) { INCREMENTAL = on; }, py::arg("on"),
+          "Update pair counts from changed rows instead of rebuilding");
+    m.def("set_parallel_backmixing", [](bool on) { PARALLEL_BACKMIXING = on; }, py::arg("on"),
+          "Evaluate back-mixing trials on the worker threads; calls to a Python objective still take turns on the GIL");
+    m.def("set_delta_eval", [](bool on) { DELTA_EVAL = on; }, py::arg("on"),
+          "Score flips and back-mixing trials from the subfunctions they touch (built-in problems)");
+    m.def("set_steepest_ghc", [](bool on) { STEEPEST_GHC = on; }, py::arg("on"),
+          "Climb the initial population by steepest ascent; cheap with set_delta_eval on built-in problems");
+    m.def("set_huge_pages", [](bool on) { HUGE_PAGES = on; }, py::arg("on"),
+          "Back the linkage graph with transparent huge pages");
+    m.def("set_row_linkage", [](bool on) { ROW_LINKAGE = on; }, py::arg("on"),
+          "Keep the linkage graph as full float rows");
+    m.def("set_sparse_k", [](int k) { SPARSE_K = k; }, py::arg("k"),
+          "Keep only the k strongest neighbours per variable; 0 keeps the full graph");
+    m.def("set_sample_size", [](int n, bool grow, double tolerance) {
+              SAMPLE_SIZE = n;
+              SAMPLE_GROW = grow;
+              SAMPLE_TOLERANCE = tolerance;
+          }, py::arg("n"), py::arg("grow") = false, py::arg("tolerance") = 0.01,
+          "Estimate linkage from n random selected rows, doubled until it settles with grow; 0 uses all");
+    m.def("set_zobrist_seed", [](unsigned long seed) { ZOBRIST_SEED = seed; }, py::arg("seed"),
+          "Seed of the Zobrist keys");
+    m.def("set_zobrist_file", &set_zobrist_file, py::arg("filename"),
+          "Read the Zobrist keys from a genZobrist file; an empty name uses the seed");
 }
\ No newline at end of file
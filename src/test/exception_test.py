@@ -0,0 +1,94 @@
+"""
+DSMGA-II Objective Exception Test
+---------------------------------
+An exception raised by a Python objective comes out of optimize() as that
+exception, whether the objective was called on the calling thread or on
+the worker threads under parallel back mixing.
+"""
+
+import sys
+import threading
+
+from dsmga2 import DSMGA2
+from dsmga2.dsmga2 import set_threads, set_parallel_backmixing
+
+
+class ObjectiveError(Exception):
+    pass
+
+
+# OneMax / 10 stays below the hit threshold DSMGA2 uses for a custom
+# problem (problem_size / 5), so the run goes on into mixing. Only back
+# mixing calls the objective off the calling thread, on the pool workers.
+
+def raise_on(calls, threads):
+    """Whether the objective raises on this call: off the calling thread
+    when the run has workers, else once past the initial population"""
+    if threads > 1:
+        return threading.get_ident() != threading.main_thread().ident
+    return calls > 60
+
+
+def raising_objective(threads):
+    """OneMax / 10 that raises where raise_on says"""
+    calls = [0]
+
+    def objective(x):
+        calls[0] += 1
+        if raise_on(calls[0], threads):
+            raise ObjectiveError(f"raised on call {calls[0]}")
+        return sum(x) / 10.0
+
+    return objective
+
+
+def raising_batch_objective(threads):
+    """Batch OneMax / 10 that raises where raise_on says"""
+    calls = [0]
+
+    def objective(xs):
+        calls[0] += len(xs)
+        if raise_on(calls[0], threads):
+            raise ObjectiveError(f"raised on batch of {len(xs)}")
+        return [sum(x) / 10.0 for x in xs]
+
+    return objective
+
+
+def raises(threads, parallel, batch):
+    """Whether optimize() raises the objective's ObjectiveError"""
+    set_threads(threads)
+    set_parallel_backmixing(parallel)
+
+    optimizer = DSMGA2(problem_size=50, population_size=60, max_generations=20)
+    if batch:
+        optimizer.set_batch_objective_function(raising_batch_objective(threads))
+    else:
+        optimizer.set_objective_function(raising_objective(threads))
+
+    try:
+        optimizer.optimize()
+    except ObjectiveError:
+        return True
+    return False
+
+
+if __name__ == "__main__":
+    cases = [
+        (1, False, False),
+        (4, True, False),
+        (1, False, True),
+        (4, True, True),
+    ]
+
+    failures = 0
+    for threads, parallel, batch in cases:
+        ok = raises(threads, parallel, batch)
+        print(f"threads={threads} parallel_backmixing={parallel} batch={batch}: "
+              f"{'raised' if ok else 'FAILED: did not raise'}")
+        if not ok:
+            failures += 1
+
+    set_threads(1)
+    set_parallel_backmixing(False)
+    sys.exit(1 if failures else 0)
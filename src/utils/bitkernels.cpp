@@ -0,0 +1,456 @@
+/***************************************************************************
+ *   Bit-matrix kernels used by model building.                            *
+ ***************************************************************************/
+
+#include <algorithm>
+#include <cstring>
+#include "bitkernels.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define BITKERNELS_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// A tile is TILE x TILE column pairs accumulated in registers.
+// Columns are processed CHUNK words at a time so that the two tiles of
+// columns being combined stay in L1, and BLOCK columns on the j side are
+// reused from L2 by every i-tile before moving on.
+const int TILE = 4;
+const int CHUNK = 128;
+const int BLOCK = 64;
+
+const unsigned long zeroColumn[CHUNK] = {0};
+
+typedef void (*TileKernel)(const unsigned long* const* a, int na,
+                           const unsigned long* const* b, int nb,
+                           int nWords, PairOp op, int acc[TILE][TILE]);
+
+template <PairOp OP>
+inline unsigned long combine(unsigned long x, unsigned long y) {
+    return (OP == PAIR_AND) ? (x & y) : (x ^ y);
+}
+
+template <PairOp OP>
+inline __attribute__((always_inline))
+void tileScalarBody(const unsigned long* const* a, const unsigned long* const* b,
+                    int nWords, int acc[TILE][TILE]) {
+    int c[TILE][TILE] = {{0}};
+    for (int k = 0; k < nWords; ++k) {
+        unsigned long va[TILE], vb[TILE];
+        for (int i = 0; i < TILE; ++i) va[i] = a[i][k];
+        for (int j = 0; j < TILE; ++j) vb[j] = b[j][k];
+        for (int i = 0; i < TILE; ++i)
+            for (int j = 0; j < TILE; ++j)
+                c[i][j] += __builtin_popcountl(combine<OP>(va[i], vb[j]));
+    }
+    for (int i = 0; i < TILE; ++i)
+        for (int j = 0; j < TILE; ++j)
+            acc[i][j] += c[i][j];
+}
+
+void tileScalar(const unsigned long* const* a, int, const unsigned long* const* b, int,
+                int nWords, PairOp op, int acc[TILE][TILE]) {
+    if (op == PAIR_AND)
+        tileScalarBody<PAIR_AND>(a, b, nWords, acc);
+    else
+        tileScalarBody<PAIR_XOR>(a, b, nWords, acc);
+}
+
+int popCountScalar(const unsigned long* col, int nWords) {
+    int n = 0;
+    for (int k = 0; k < nWords; ++k)
+        n += __builtin_popcountl(col[k]);
+    return n;
+}
+
+// In-place transpose of a 64x64 bit block, bit c of a[r] <-> bit r of a[c],
+// by swapping off-diagonal blocks of halving size (Hacker's Delight 7-3).
+inline void transposeStep(unsigned long* a, int j, unsigned long m) {
+    for (int k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+        unsigned long t = ((a[k] >> j) ^ a[k | j]) & m;
+        a[k] ^= t << j;
+        a[k | j] ^= t;
+    }
+}
+
+void transpose64Scalar(unsigned long* a) {
+    unsigned long m = 0x00000000fffffffful;
+    for (int j = 32; j != 0; j >>= 1, m ^= m << j)
+        transposeStep(a, j, m);
+}
+
+void addByBitsScalar(float* acc, const float* same, const float* diff,
+                     const unsigned long* bits, int allele, int n) {
+    const unsigned long flip = allele ? 0ul : ~0ul;
+    for (int j = 0; j < n; ++j)
+        acc[j] += (((bits[j >> 6] ^ flip) >> (j & 63)) & 1) ? same[j] : diff[j];
+}
+
+float maxValueScalar(const float* v, int n) {
+    float m = v[0];
+    for (int j = 1; j < n; ++j)
+        if (m < v[j]) m = v[j];
+    return m;
+}
+
+#ifdef BITKERNELS_X86
+
+__attribute__((target("popcnt")))
+void tilePopcnt(const unsigned long* const* a, int, const unsigned long* const* b, int,
+                int nWords, PairOp op, int acc[TILE][TILE]) {
+    if (op == PAIR_AND)
+        tileScalarBody<PAIR_AND>(a, b, nWords, acc);
+    else
+        tileScalarBody<PAIR_XOR>(a, b, nWords, acc);
+}
+
+__attribute__((target("popcnt")))
+int popCountPopcnt(const unsigned long* col, int nWords) {
+    int n = 0;
+    for (int k = 0; k < nWords; ++k)
+        n += __builtin_popcountl(col[k]);
+    return n;
+}
+
+// AVX2: like AVX-512 below, the 16 pair accumulators of the tile stay
+// in registers across the chunk. Mula's nibble lookup counts bytes; the
+// byte counts of 4 vectors are summed before one widening sad.
+
+__attribute__((target("avx2")))
+inline __m256i popcountBytes(__m256i v) {
+    const __m256i lookup = _mm256_setr_epi8(
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i lowMask = _mm256_set1_epi8(0x0f);
+    __m256i lo = _mm256_and_si256(v, lowMask);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), lowMask);
+    return _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo),
+                           _mm256_shuffle_epi8(lookup, hi));
+}
+
+template <PairOp OP>
+__attribute__((target("avx2")))
+inline __m256i combine256(const unsigned long* x, const unsigned long* y) {
+    __m256i vx = _mm256_loadu_si256((const __m256i*) x);
+    __m256i vy = _mm256_loadu_si256((const __m256i*) y);
+    return (OP == PAIR_AND) ? _mm256_and_si256(vx, vy) : _mm256_xor_si256(vx, vy);
+}
+
+template <PairOp OP>
+__attribute__((target("avx2,popcnt")))
+inline void tileAvx2Body(const unsigned long* const* a, const unsigned long* const* b,
+                         int nWords, int acc[TILE][TILE]) {
+    __m256i c[TILE][TILE];
+    for (int i = 0; i < TILE; ++i)
+        for (int j = 0; j < TILE; ++j)
+            c[i][j] = _mm256_setzero_si256();
+
+    int k = 0;
+    for (; k + 16 <= nWords; k += 16)
+        for (int i = 0; i < TILE; ++i)
+            for (int j = 0; j < TILE; ++j) {
+                __m256i bytes = _mm256_add_epi8(
+                    _mm256_add_epi8(popcountBytes(combine256<OP>(a[i] + k, b[j] + k)),
+                                    popcountBytes(combine256<OP>(a[i] + k + 4, b[j] + k + 4))),
+                    _mm256_add_epi8(popcountBytes(combine256<OP>(a[i] + k + 8, b[j] + k + 8)),
+                                    popcountBytes(combine256<OP>(a[i] + k + 12, b[j] + k + 12))));
+                c[i][j] = _mm256_add_epi64(c[i][j], _mm256_sad_epu8(bytes, _mm256_setzero_si256()));
+            }
+    for (; k + 4 <= nWords; k += 4)
+        for (int i = 0; i < TILE; ++i)
+            for (int j = 0; j < TILE; ++j)
+                c[i][j] = _mm256_add_epi64(c[i][j], _mm256_sad_epu8(
+                    popcountBytes(combine256<OP>(a[i] + k, b[j] + k)), _mm256_setzero_si256()));
+
+    long lanes[4];
+    for (int i = 0; i < TILE; ++i)
+        for (int j = 0; j < TILE; ++j) {
+            _mm256_storeu_si256((__m256i*) lanes, c[i][j]);
+            long n = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+            for (int r = k; r < nWords; ++r)
+                n += __builtin_popcountl(combine<OP>(a[i][r], b[j][r]));
+            acc[i][j] += (int) n;
+        }
+}
+
+__attribute__((target("avx2,popcnt")))
+void tileAvx2(const unsigned long* const* a, int, const unsigned long* const* b, int,
+              int nWords, PairOp op, int acc[TILE][TILE]) {
+    if (op == PAIR_AND)
+        tileAvx2Body<PAIR_AND>(a, b, nWords, acc);
+    else
+        tileAvx2Body<PAIR_XOR>(a, b, nWords, acc);
+}
+
+// AVX-512: all 16 pair accumulators of the tile live in zmm registers.
+
+template <PairOp OP>
+__attribute__((target("avx512f,avx512vpopcntdq")))
+inline void tileAvx512Body(const unsigned long* const* a, const unsigned long* const* b,
+                           int nWords, int acc[TILE][TILE]) {
+    __m512i c[TILE][TILE];
+    for (int i = 0; i < TILE; ++i)
+        for (int j = 0; j < TILE; ++j)
+            c[i][j] = _mm512_setzero_si512();
+
+    int k = 0;
+    for (; k < nWords; k += 8) {
+        __mmask8 m = (nWords - k >= 8) ? (__mmask8) 0xff : (__mmask8) ((1u << (nWords - k)) - 1);
+        __m512i va[TILE], vb[TILE];
+        for (int i = 0; i < TILE; ++i) va[i] = _mm512_maskz_loadu_epi64(m, a[i] + k);
+        for (int j = 0; j < TILE; ++j) vb[j] = _mm512_maskz_loadu_epi64(m, b[j] + k);
+        for (int i = 0; i < TILE; ++i)
+            for (int j = 0; j < TILE; ++j) {
+                __m512i v = (OP == PAIR_AND) ? _mm512_and_si512(va[i], vb[j])
+                                             : _mm512_xor_si512(va[i], vb[j]);
+                c[i][j] = _mm512_add_epi64(c[i][j], _mm512_popcnt_epi64(v));
+            }
+    }
+
+    long lanes[8];
+    for (int i = 0; i < TILE; ++i)
+        for (int j = 0; j < TILE; ++j) {
+            _mm512_storeu_si512(lanes, c[i][j]);
+            acc[i][j] += (int) (lanes[0] + lanes[1] + lanes[2] + lanes[3]
+                              + lanes[4] + lanes[5] + lanes[6] + lanes[7]);
+        }
+}
+
+__attribute__((target("avx512f,avx512vpopcntdq")))
+void tileAvx512(const unsigned long* const* a, int, const unsigned long* const* b, int,
+                int nWords, PairOp op, int acc[TILE][TILE]) {
+    if (op == PAIR_AND)
+        tileAvx512Body<PAIR_AND>(a, b, nWords, acc);
+    else
+        tileAvx512Body<PAIR_XOR>(a, b, nWords, acc);
+}
+
+// AVX2: the four steps that swap whole groups of 4+ words run on
+// 4 words at a time; the last two stay scalar.
+__attribute__((target("avx2")))
+void transpose64Avx2(unsigned long* a) {
+    unsigned long m = 0x00000000fffffffful;
+    int j = 32;
+    for (; j >= 4; j >>= 1, m ^= m << j) {
+        const __m256i mask = _mm256_set1_epi64x((long long) m);
+        const __m128i shift = _mm_cvtsi32_si128(j);
+        for (int k = 0; k < 64; k += 2 * j)
+            for (int i = k; i < k + j; i += 4) {
+                __m256i x = _mm256_loadu_si256((const __m256i*) (a + i));
+                __m256i y = _mm256_loadu_si256((const __m256i*) (a + i + j));
+                __m256i t = _mm256_and_si256(_mm256_xor_si256(_mm256_srl_epi64(x, shift), y), mask);
+                _mm256_storeu_si256((__m256i*) (a + i), _mm256_xor_si256(x, _mm256_sll_epi64(t, shift)));
+                _mm256_storeu_si256((__m256i*) (a + i + j), _mm256_xor_si256(y, t));
+            }
+    }
+    for (; j != 0; j >>= 1, m ^= m << j)
+        transposeStep(a, j, m);
+}
+
+__attribute__((target("avx2")))
+void addByBitsAvx2(float* acc, const float* same, const float* diff,
+                   const unsigned long* bits, int allele, int n) {
+    const unsigned long flip = allele ? 0ul : ~0ul;
+    const __m256i select = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    for (int j = 0; j < n; j += 8) {
+        int byte = (int) (((bits[j >> 6] ^ flip) >> (j & 63)) & 0xff);
+        __m256i v = _mm256_and_si256(_mm256_set1_epi32(byte), select);
+        __m256 m = _mm256_castsi256_ps(_mm256_cmpeq_epi32(v, select));
+        __m256 r = _mm256_blendv_ps(_mm256_load_ps(diff + j), _mm256_load_ps(same + j), m);
+        _mm256_storeu_ps(acc + j, _mm256_add_ps(_mm256_loadu_ps(acc + j), r));
+    }
+}
+
+__attribute__((target("avx2")))
+float maxValueAvx2(const float* v, int n) {
+    __m256 m = _mm256_loadu_ps(v);
+    for (int j = 8; j < n; j += 8)
+        m = _mm256_max_ps(m, _mm256_loadu_ps(v + j));
+    float lanes[8];
+    _mm256_storeu_ps(lanes, m);
+    return maxValueScalar(lanes, 8);
+}
+
+__attribute__((target("avx512f")))
+void addByBitsAvx512(float* acc, const float* same, const float* diff,
+                     const unsigned long* bits, int allele, int n) {
+    const unsigned long flip = allele ? 0ul : ~0ul;
+    for (int j = 0; j < n; j += 16) {
+        __mmask16 k = (__mmask16) ((bits[j >> 6] ^ flip) >> (j & 63));
+        __m512 r = _mm512_mask_blend_ps(k, _mm512_load_ps(diff + j), _mm512_load_ps(same + j));
+        _mm512_storeu_ps(acc + j, _mm512_add_ps(_mm512_loadu_ps(acc + j), r));
+    }
+}
+
+__attribute__((target("avx512f")))
+float maxValueAvx512(const float* v, int n) {
+    // the masked max passes m through instead of _mm512_max_ps's undefined vector
+    __m512 m = _mm512_loadu_ps(v);
+    for (int j = 16; j < n; j += 16)
+        m = _mm512_mask_max_ps(m, (__mmask16) 0xffff, m, _mm512_loadu_ps(v + j));
+    float lanes[16];
+    _mm512_storeu_ps(lanes, m);
+    return maxValueScalar(lanes, 16);
+}
+
+#endif
+
+// kernel sets from the most portable up; a Dispatch takes the best one
+// the CPU has, up to a given level
+enum Level { LEVEL_SCALAR, LEVEL_POPCNT, LEVEL_AVX2, LEVEL_AVX512, N_LEVELS };
+
+const char* const levelNames[N_LEVELS] = { "scalar", "popcnt", "avx2", "avx512vpopcntdq" };
+
+struct Dispatch {
+    TileKernel tile;
+    int (*popCount)(const unsigned long*, int);
+    void (*transpose64)(unsigned long*);
+    void (*addByBits)(float*, const float*, const float*, const unsigned long*, int, int);
+    float (*maxValue)(const float*, int);
+    const char* name;
+
+    explicit Dispatch(int level) {
+        tile = tileScalar;
+        popCount = popCountScalar;
+        transpose64 = transpose64Scalar;
+        addByBits = addByBitsScalar;
+        maxValue = maxValueScalar;
+        name = levelNames[LEVEL_SCALAR];
+#ifdef BITKERNELS_X86
+        __builtin_cpu_init();
+        if (level >= LEVEL_POPCNT && __builtin_cpu_supports("popcnt")) {
+            tile = tilePopcnt;
+            popCount = popCountPopcnt;
+            name = levelNames[LEVEL_POPCNT];
+        }
+        if (level >= LEVEL_AVX2 && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+            tile = tileAvx2;
+            name = levelNames[LEVEL_AVX2];
+        }
+        if (level >= LEVEL_AVX2 && __builtin_cpu_supports("avx2")) {
+            transpose64 = transpose64Avx2;
+            addByBits = addByBitsAvx2;
+            maxValue = maxValueAvx2;
+        }
+        if (level >= LEVEL_AVX512 && __builtin_cpu_supports("avx512f")) {
+            addByBits = addByBitsAvx512;
+            maxValue = maxValueAvx512;
+        }
+        if (level >= LEVEL_AVX512 && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq")) {
+            tile = tileAvx512;
+            name = levelNames[LEVEL_AVX512];
+        }
+#else
+        (void) level;
+#endif
+    }
+};
+
+Dispatch& dispatch() {
+    static Dispatch d(N_LEVELS - 1);
+    return d;
+}
+
+}  // namespace
+
+
+void pairCount(const unsigned long* const* cols, int nWords,
+               int i0, int i1, int j0, int j1,
+               PairOp op, int* out, int ldOut) {
+
+    TileKernel tile = dispatch().tile;
+
+    for (int i = i0; i < i1; ++i)
+        std::fill(out + (i - i0) * ldOut, out + (i - i0) * ldOut + (j1 - j0), 0);
+
+    const unsigned long* a[TILE];
+    const unsigned long* b[TILE];
+
+    for (int c0 = 0; c0 < nWords; c0 += CHUNK) {
+        int cw = std::min(CHUNK, nWords - c0);
+
+        for (int jb = j0; jb < j1; jb += BLOCK) {
+            int jbEnd = std::min(jb + BLOCK, j1);
+
+            for (int ti = i0; ti < i1; ti += TILE) {
+                int na = std::min(TILE, i1 - ti);
+                for (int i = 0; i < TILE; ++i)
+                    a[i] = (i < na) ? cols[ti + i] + c0 : zeroColumn;
+
+                for (int tj = jb; tj < jbEnd; tj += TILE) {
+                    int nb = std::min(TILE, jbEnd - tj);
+                    for (int j = 0; j < TILE; ++j)
+                        b[j] = (j < nb) ? cols[tj + j] + c0 : zeroColumn;
+
+                    int acc[TILE][TILE] = {{0}};
+                    tile(a, na, b, nb, cw, op, acc);
+
+                    for (int i = 0; i < na; ++i) {
+                        int* row = out + (ti + i - i0) * ldOut + (tj - j0);
+                        for (int j = 0; j < nb; ++j)
+                            row[j] += acc[i][j];
+                    }
+                }
+            }
+        }
+    }
+}
+
+void transposeBits(const unsigned long* const* rows, int nRows, int nBits,
+                   unsigned long* const* cols) {
+
+    void (*transpose64)(unsigned long*) = dispatch().transpose64;
+    unsigned long block[64];
+
+    for (int r0 = 0; r0 < nRows; r0 += 64) {
+        int nr = std::min(64, nRows - r0);
+        int w = r0 / 64;
+
+        for (int c0 = 0; c0 < nBits; c0 += 64) {
+            int nc = std::min(64, nBits - c0);
+            int v = c0 / 64;
+
+            for (int r = 0; r < nr; ++r)
+                block[r] = rows[r0 + r][v];
+            for (int r = nr; r < 64; ++r)
+                block[r] = 0;
+
+            transpose64(block);
+
+            for (int c = 0; c < nc; ++c)
+                cols[c0 + c][w] = block[c];
+        }
+    }
+}
+
+void addByBits(float* acc, const float* same, const float* diff,
+               const unsigned long* bits, int allele, int n) {
+    dispatch().addByBits(acc, same, diff, bits, allele, n);
+}
+
+float maxValue(const float* v, int n) {
+    return dispatch().maxValue(v, n);
+}
+
+int popCount(const unsigned long* col, int nWords) {
+    return dispatch().popCount(col, nWords);
+}
+
+const char* bitKernelName() {
+    return dispatch().name;
+}
+
+bool selectBitKernel(const char* name) {
+    for (int level = 0; level < N_LEVELS; ++level) {
+        if (strcmp(name, levelNames[level]) != 0)
+            continue;
+        Dispatch d(level);
+        if (strcmp(d.name, name) != 0)
+            return false;
+        dispatch() = d;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,75 @@
+/***************************************************************************
+ *   Bit-matrix kernels used by model building.                            *
+ *                                                                         *
+ *   pairCount() is a blocked all-pairs popcount ("bit GEMM") over         *
+ *   FastCounting columns, a 4x4 tile of pairs at a time. The tile         *
+ *   kernel is picked once at runtime from the CPU, independent of the     *
+ *   flags the binary was compiled with: AVX-512 VPOPCNTDQ, else AVX2      *
+ *   counting bytes with a vpshufb nibble lookup, else the popcnt          *
+ *   instruction, else portable scalar code.                               *
+ *                                                                         *
+ *   transposeBits() turns row-major chromosomes into those columns        *
+ *   64x64 bits at a time. addByBits() and maxValue() serve mask growth    *
+ *   over LinkageRows.                                                     *
+ ***************************************************************************/
+
+#ifndef _BITKERNELS_H_
+#define _BITKERNELS_H_
+
+// For the functions that count bits with __builtin_popcountl outside
+// these kernels. The build targets the baseline ISA, which lacks the
+// popcnt instruction, so they get a popcnt clone next to the portable
+// one and the loader picks one for the CPU once (GNU ifunc).
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && defined(__ELF__) && !defined(__POPCNT__)
+#define POPCNT_CLONES __attribute__((target_clones("popcnt", "default")))
+#else
+#define POPCNT_CLONES
+#endif
+
+enum PairOp {
+    PAIR_AND = 0,   // n11
+    PAIR_XOR = 1    // n01 + n10
+};
+
+/**
+ *  out[(i-i0)*ldOut + (j-j0)] = popcount(cols[i] OP cols[j])
+ *  for i in [i0, i1), j in [j0, j1), each column being nWords long.
+ */
+void pairCount(const unsigned long* const* cols, int nWords,
+               int i0, int i1, int j0, int j1,
+               PairOp op, int* out, int ldOut);
+
+/**
+ *  Bit-matrix transpose from rows to columns:
+ *  bit r of cols[c] = bit c of rows[r], for r < nRows and c < nBits.
+ *  Writes words [0, ceil(nRows/64)) of every column; bits at and past
+ *  nRows in the last of them are cleared.
+ */
+void transposeBits(const unsigned long* const* rows, int nRows, int nBits,
+                   unsigned long* const* cols);
+
+/**
+ *  acc[j] += (bit j of bits == allele) ? same[j] : diff[j], for j < n.
+ *  n is a multiple of 16, same and diff are 64-byte aligned and bits
+ *  covers n bits.
+ */
+void addByBits(float* acc, const float* same, const float* diff,
+               const unsigned long* bits, int allele, int n);
+
+/** largest of v[0 .. n), n a positive multiple of 16 */
+float maxValue(const float* v, int n);
+
+/** popcount of a single column */
+int popCount(const unsigned long* col, int nWords);
+
+/** name of the kernel selected for this CPU */
+const char* bitKernelName();
+
+/**
+ *  Switches to the kernels bitKernelName() reports as name: "scalar",
+ *  "popcnt", "avx2" or "avx512vpopcntdq". Returns false, keeping the
+ *  current ones, if this CPU lacks them. For tests; not thread-safe.
+ */
+bool selectBitKernel(const char* name);
+
+#endif
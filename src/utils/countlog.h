@@ -0,0 +1,57 @@
+/*************************************
+ *
+ *  log(c) and c*log(c) for integer counts c in [0, n].
+ *
+ *  Every probability in model building is a count over the same
+ *  population size, so all the logs the linkage and MI formulas need
+ *  can be looked up instead of computed. Entries for c = 0 are 0.
+ *
+**************************************/
+
+
+#ifndef _COUNTLOG_H_
+#define _COUNTLOG_H_
+
+#include <cmath>
+#include <vector>
+
+
+class CountLog {
+
+public:
+
+    CountLog() : n(-1) {}
+
+    void init(int _n) {
+        if (_n == n) return;
+        n = _n;
+        logs.assign(n + 1, 0.0);
+        nLogNs.assign(n + 1, 0.0);
+        for (int c = 1; c <= n; ++c) {
+            logs[c] = std::log((double) c);
+            nLogNs[c] = c * logs[c];
+        }
+    }
+
+    int size() const {
+        return n;
+    }
+
+    double log(int c) const {
+        return logs[c];
+    }
+
+    double nLogN(int c) const {
+        return nLogNs[c];
+    }
+
+private:
+
+    int n;
+    std::vector<double> logs;
+    std::vector<double> nLogNs;
+
+};
+
+
+#endif
@@ -6,18 +6,26 @@
 
 #define SIZE (1000)
 
-int main() {
+// genZobrist [count]: count keys, SIZE by default; DSMGA2 reads them
+// when ZOBRIST_FILE is set
+int main(int argc, char* argv[]) {
+    int count = (argc > 1) ? atoi(argv[1]) : SIZE;
+    if (count <= 0) {
+        std::cerr << "Usage: genZobrist [count]\n";
+        return 1;
+    }
+
     std::cout << "Zobrist keys are " << sizeof(unsigned long)*8 << " bits.\n";
     
     // Generate keys using simple random
-    std::vector<unsigned long> keys(SIZE);
+    std::vector<unsigned long> keys(count);
     srand(time(NULL));
     
-    for (int i = 0; i < SIZE; ++i) {
+    for (int i = 0; i < count; ++i) {
         keys[i] = ((unsigned long)rand() << 32) | rand();
     }
     
-    std::cout << SIZE << " keys are generated.\n";
+    std::cout << count << " keys are generated.\n";
     
     // Write to file using basic file operations
     const char* filename = "bin/zobristkey";
@@ -37,7 +45,7 @@ int main() {
     }
     
     outFile.write(reinterpret_cast<const char*>(keys.data()), 
-                  SIZE * sizeof(unsigned long));
+                  count * sizeof(unsigned long));
     
     if (!outFile) {
         std::cerr << "Error: Failed to write to file: " << filename << std::endl;
@@ -0,0 +1,84 @@
+#ifndef _GENE_ARENA_
+#define _GENE_ARENA_
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/*
+ * The genes of a whole population as one row-major bit matrix: row(k)
+ * is the gene of individual k, words long, and every row starts on a
+ * 64-byte boundary. Chromosome::attach makes a chromosome a view of a
+ * row. Rows start out zero.
+ */
+class GeneArena {
+
+public:
+    GeneArena() {
+        rows = NULL;
+        size = 0;
+        words = 0;
+        stride = 0;
+    }
+
+    void init(int n, int _words) {
+        release();
+        size = n;
+        words = _words;
+        stride = (words + 7) / 8 * 8;
+        if (n == 0 || words == 0)
+            return;
+
+        void* p = NULL;
+        size_t bytes = (size_t) n * stride * sizeof(unsigned long);
+        if (posix_memalign(&p, 64, bytes) != 0) {
+            fprintf(stderr, "GeneArena: out of memory\n");
+            exit(1);
+        }
+        rows = static_cast<unsigned long*>(p);
+        memset(rows, 0, bytes);
+    }
+
+    void release() {
+        free(rows);
+        rows = NULL;
+        size = 0;
+        words = 0;
+        stride = 0;
+    }
+
+    ~GeneArena() {
+        release();
+    }
+
+    unsigned long* row(int k) {
+        return rows + (size_t) k * stride;
+    }
+
+    const unsigned long* row(int k) const {
+        return rows + (size_t) k * stride;
+    }
+
+    int getSize() const {
+        return size;
+    }
+
+    int getWords() const {
+        return words;
+    }
+
+    int getStride() const {
+        return stride;
+    }
+
+private:
+    GeneArena(const GeneArena&);
+    GeneArena& operator=(const GeneArena&);
+
+    unsigned long* rows;
+    int size;
+    int words;
+    int stride;
+
+};
+#endif
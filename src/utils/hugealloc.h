@@ -0,0 +1,84 @@
+#ifndef _HUGE_ALLOC_
+#define _HUGE_ALLOC_
+
+#include <cstdio>
+#include <cstdlib>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+/*
+ * One 64-byte aligned block of memory, the storage of TriMatrix and
+ * LinkageRows. allocate(n, true) maps whole 2 MB pages and asks for
+ * transparent huge pages where the OS has them, and falls back to
+ * posix_memalign when the mapping fails. The contents start undefined.
+ */
+class HugeBlock {
+
+public:
+    HugeBlock() {
+        ptr = NULL;
+        bytes = 0;
+        mapped = false;
+    }
+
+    ~HugeBlock() {
+        release();
+    }
+
+    // owner names the caller in the out-of-memory message
+    void* allocate(size_t n, bool hugePages, const char* owner) {
+        release();
+        const size_t align = 64;
+        bytes = (n + align - 1) / align * align;
+        if (bytes == 0)
+            bytes = align;
+#ifdef __linux__
+        if (hugePages) {
+            const size_t hugePage = 2 << 20;
+            size_t mapBytes = (bytes + hugePage - 1) / hugePage * hugePage;
+            void* p = mmap(NULL, mapBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p != MAP_FAILED) {
+#ifdef MADV_HUGEPAGE
+                madvise(p, mapBytes, MADV_HUGEPAGE);
+#endif
+                ptr = p;
+                bytes = mapBytes;
+                mapped = true;
+                return ptr;
+            }
+        }
+#endif
+        if (posix_memalign(&ptr, align, bytes) != 0) {
+            fprintf(stderr, "%s: out of memory\n", owner);
+            exit(1);
+        }
+        mapped = false;
+        return ptr;
+    }
+
+    void release() {
+        if (ptr == NULL)
+            return;
+#ifdef __linux__
+        if (mapped)
+            munmap(ptr, bytes);
+        else
+#endif
+            free(ptr);
+        ptr = NULL;
+        bytes = 0;
+        mapped = false;
+    }
+
+private:
+    HugeBlock(const HugeBlock&);
+    HugeBlock& operator=(const HugeBlock&);
+
+    void* ptr;
+    size_t bytes;
+    bool mapped;
+
+};
+#endif
@@ -0,0 +1,101 @@
+#ifndef _LINKAGE_ROWS_
+#define _LINKAGE_ROWS_
+
+#include <utility>
+
+#include "hugealloc.h"
+
+using namespace std;
+
+/*
+ * Two-edge linkage as full symmetric float rows, the same information
+ * TriMatrix<double> holds: same(i)[j] is the 00/11 linkage of i and j,
+ * diff(i)[j] the 01/10 one. Every row is padded to a multiple of 16
+ * floats and starts on a 64-byte boundary; the diagonal and the padding
+ * are 0. init(n, true) asks for transparent huge pages.
+ */
+class LinkageRows {
+
+public:
+    LinkageRows() {
+        rows = NULL;
+        size = 0;
+        stride = 0;
+        huge = false;
+    }
+
+    void init(int n, bool hugePages = false) {
+        if (n == 0)
+            return;
+
+        if (n != size || hugePages != huge) {
+            release();
+            size = n;
+            stride = (n + 15) / 16 * 16;
+            huge = hugePages;
+            rows = static_cast<float*>(block.allocate((size_t) 2 * n * stride * sizeof(float), hugePages, "LinkageRows"));
+        }
+        for (size_t k = 0; k < (size_t) 2 * size * stride; k++)
+            rows[k] = 0.0f;
+    }
+
+    void release() {
+        block.release();
+        rows = NULL;
+        size = 0;
+        stride = 0;
+        huge = false;
+    }
+
+    ~LinkageRows() {
+        release();
+    }
+
+    void write(int i, int j, const pair<double, double>& val) {
+        if (i == j) return;
+        same(i)[j] = same(j)[i] = (float) val.first;
+        diff(i)[j] = diff(j)[i] = (float) val.second;
+    }
+
+    pair<double, double> operator()(int i, int j) const {
+        if (i == j)
+            return pair<double, double>(1.0, 1.0);
+        return pair<double, double>(same(i)[j], diff(i)[j]);
+    }
+
+    float* same(int i) {
+        return rows + (size_t) 2 * i * stride;
+    }
+
+    float* diff(int i) {
+        return rows + (size_t) (2 * i + 1) * stride;
+    }
+
+    const float* same(int i) const {
+        return rows + (size_t) 2 * i * stride;
+    }
+
+    const float* diff(int i) const {
+        return rows + (size_t) (2 * i + 1) * stride;
+    }
+
+    int getSize() const {
+        return size;
+    }
+
+    int getStride() const {
+        return stride;
+    }
+
+private:
+    LinkageRows(const LinkageRows&);
+    LinkageRows& operator=(const LinkageRows&);
+
+    HugeBlock block;
+    float* rows;
+    int size;
+    int stride;
+    bool huge;
+
+};
+#endif
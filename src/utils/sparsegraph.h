@@ -0,0 +1,88 @@
+#ifndef _SPARSE_GRAPH_
+#define _SPARSE_GRAPH_
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+/*
+ * Symmetric two-edge graph in CSR form: for every node the neighbours
+ * it kept, sorted by index, with the same pair<T, T> of edge weights
+ * TriMatrix stores. Built from one candidate list per node; an edge
+ * kept by either end is stored at both.
+ */
+template<class T> class SparseGraph {
+
+public:
+    typedef pair<int, pair<T, T> > Edge;
+
+    SparseGraph() {
+        size = 0;
+    }
+
+    void build(const vector<vector<Edge> >& candidates) {
+        size = (int) candidates.size();
+
+        vector<int> degree(size, 0);
+        for (int i = 0; i < size; i++)
+            for (size_t e = 0; e < candidates[i].size(); e++) {
+                degree[i]++;
+                degree[candidates[i][e].first]++;
+            }
+
+        vector<vector<Edge> > rows(size);
+        for (int i = 0; i < size; i++)
+            rows[i].reserve(degree[i]);
+        for (int i = 0; i < size; i++)
+            for (size_t e = 0; e < candidates[i].size(); e++) {
+                const Edge& edge = candidates[i][e];
+                rows[i].push_back(edge);
+                rows[edge.first].push_back(Edge(i, edge.second));
+            }
+
+        start.assign(size + 1, 0);
+        neighbour.clear();
+        weight.clear();
+        for (int i = 0; i < size; i++) {
+            sort(rows[i].begin(), rows[i].end(), lessIndex);
+            for (size_t e = 0; e < rows[i].size(); e++) {
+                if (e > 0 && rows[i][e].first == rows[i][e - 1].first)
+                    continue;
+                neighbour.push_back(rows[i][e].first);
+                weight.push_back(rows[i][e].second);
+            }
+            start[i + 1] = (int) neighbour.size();
+            vector<Edge>().swap(rows[i]);
+        }
+    }
+
+    int getSize() const {
+        return size;
+    }
+
+    int degree(int i) const {
+        return start[i + 1] - start[i];
+    }
+
+    const int* neighbours(int i) const {
+        return neighbour.data() + start[i];
+    }
+
+    const pair<T, T>* edges(int i) const {
+        return weight.data() + start[i];
+    }
+
+private:
+    static bool lessIndex(const Edge& a, const Edge& b) {
+        return a.first < b.first;
+    }
+
+    int size;
+    vector<int> start;
+    vector<int> neighbour;
+    vector<pair<T, T> > weight;
+
+};
+#endif
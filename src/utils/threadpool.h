@@ -0,0 +1,142 @@
+/*************************************
+ *
+ *  Fixed-size pool of worker threads.
+ *
+ *  run(nTasks, fn) calls fn(task, worker) for every task in [0, nTasks)
+ *  and returns once all of them are done. Tasks are handed out
+ *  dynamically; the calling thread takes part as worker 0, so a pool of
+ *  size 1 owns no threads and simply runs the tasks in order.
+ *
+ *  If a task throws, no further tasks are handed out; run() waits for
+ *  the ones already running and rethrows the first exception.
+ *
+**************************************/
+
+
+#ifndef _THREADPOOL_H_
+#define _THREADPOOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+class ThreadPool {
+
+public:
+
+    ThreadPool(int nThreads) {
+        workerCount = (nThreads < 1) ? 1 : nThreads;
+        job = NULL;
+        jobSize = 0;
+        next = 0;
+        generation = 0;
+        busy = 0;
+        stopping = false;
+        for (int w = 1; w < workerCount; ++w)
+            threads.push_back(std::thread(&ThreadPool::loop, this, w));
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (size_t i = 0; i < threads.size(); ++i)
+            threads[i].join();
+    }
+
+    int size() const {
+        return workerCount;
+    }
+
+    void run(int nTasks, const std::function<void(int, int)>& fn) {
+        if (workerCount == 1 || nTasks <= 1) {
+            for (int t = 0; t < nTasks; ++t)
+                fn(t, 0);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &fn;
+            jobSize = nTasks;
+            next = 0;
+            busy = workerCount - 1;
+            error = nullptr;
+            ++generation;
+        }
+        wake.notify_all();
+
+        work(0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return busy == 0; });
+        job = NULL;
+        if (error) {
+            std::exception_ptr e = error;
+            error = nullptr;
+            std::rethrow_exception(e);
+        }
+    }
+
+private:
+
+    // an exception is kept for run(), not let out of a pool thread
+    void work(int worker) {
+        for (int t = next++; t < jobSize; t = next++) {
+            try {
+                (*job)(t, worker);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error)
+                    error = std::current_exception();
+                next = jobSize;
+            }
+        }
+    }
+
+    void loop(int worker) {
+        unsigned long seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this, seen] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+            }
+
+            work(worker);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                --busy;
+            }
+            done.notify_one();
+        }
+    }
+
+    int workerCount;
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    const std::function<void(int, int)>* job;
+    int jobSize;
+    std::atomic<int> next;
+    std::exception_ptr error;       // the first a task of the job threw
+    unsigned long generation;
+    int busy;
+    bool stopping;
+
+};
+
+
+#endif
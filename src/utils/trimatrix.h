@@ -3,97 +3,91 @@
 
 #include <cassert>
 #include <cstdio>
+#include <utility>
 
+#include "hugealloc.h"
+
+using namespace std;
+
+/*
+ * Symmetric two-edge matrix without the diagonal. Entry (i, j), i > j,
+ * lives at i*(i-1)/2 + j of one 64-byte aligned block of pair<T, T>, so
+ * TriMatrix<float> takes 8 bytes per pair and TriMatrix<double> 16.
+ * init(n, true) asks for transparent huge pages where the OS has them.
+ */
 template<class T> class TriMatrix {
 
 public:
     TriMatrix() {
         matrix = NULL;
         size = 0;
+        huge = false;
     }
-    TriMatrix(int n) {
+    TriMatrix(int n, bool hugePages = false) {
         matrix = NULL;
         size = 0;
-        init(n);
+        huge = false;
+        init(n, hugePages);
     }
-    void init(int n) {
+    void init(int n, bool hugePages = false) {
         if (n == 0)
             return;
 
-        if (n == size) {
-            for (int i = 0; i < size - 1; i++)
-                for (int j = 0; j <= i; j++)
-                    matrix[i][j] = pair<double, double>(0.0, 0.0);
-                    //matrix[i][j] = T(0.0);
-        } else {
+        if (n != size || hugePages != huge) {
             release();
             size = n;
-            matrix = new pair<double, double>*[size - 1];
-            for (int i = 0; i < size - 1; i++)
-                matrix[i] = new pair<double, double>[i + 1];
-            for (int i = 0; i < size - 1; i++)
-                for (int j = 0; j <= i; j++)
-                    matrix[i][j] = pair<double, double>(0.0, 0.0);
-                    //matrix[i][j] = T(0.0);
+            huge = hugePages;
+            size_t pairs = (size_t) n * (n - 1) / 2;
+            matrix = static_cast<pair<T, T>*>(block.allocate(pairs * sizeof(pair<T, T>), hugePages, "TriMatrix"));
         }
+        for (size_t k = 0; k < (size_t) size * (size - 1) / 2; k++)
+            matrix[k] = pair<T, T>(T(0.0), T(0.0));
     }
     void release() {
-        if (matrix == NULL)
-            return;
-        for (int i = 0; i < size - 1; i++)
-            delete[] (matrix[i]);
-        delete[] matrix;
+        block.release();
+        matrix = NULL;
         size = 0;
+        huge = false;
     }
 
     ~TriMatrix() {
         release();
     }
-/*
-    void dec(int i, int j, int step=1) {
-        if (i==j) return;
-        if (i < j)
-            matrix[j-1][i]-=step;
-        else
-            matrix[i-1][j]-=step;
-    }
 
-    void inc(int i, int j, int step=1) {
-        if (i==j) return;
-        dec(i, j, -step);
-    }
-*/
-
-    //void write(int i, int j, T val) {
-    void write(int i, int j, pair<double,double> val) {
+    void write(int i, int j, const pair<T, T>& val) {
         assert(i < size && j < size);
         if (i == j) return;
-        if (i < j) {
-            int temp = i;
-            i = j;
-            j = temp;
-        }
-        matrix[i - 1][j] = val;
+        matrix[index(i, j)] = val;
     }
 
-    //T operator()(int i, int j) const {
-    pair<T,T> operator()(int i, int j) const {
+    pair<T, T> operator()(int i, int j) const {
         if (i == j)
-            return pair<double, double>(1.0, 1.0);
-            //return T(1.0);
+            return pair<T, T>(T(1.0), T(1.0));
         assert(i < size && j < size);
+        return matrix[index(i, j)];
+    }
+
+    const pair<T, T>* data() const {
+        return matrix;
+    }
+
+    static size_t index(int i, int j) {
         if (i < j) {
             int temp = i;
             i = j;
             j = temp;
         }
-        return matrix[i - 1][j];
+        return (size_t) i * (i - 1) / 2 + j;
     }
 
 private:
-    pair<double, double>** matrix;
-    //T** matrix;
-	int size;
+    TriMatrix(const TriMatrix&);
+    TriMatrix& operator=(const TriMatrix&);
+
+    HugeBlock block;
+    pair<T, T>* matrix;
+    int size;
+    bool huge;
 
 };
 #endif
@@ -1,50 +1,65 @@
 #ifndef __ZKEY__
 #define __ZKEY__
 
-#include <array>
 #include <fstream>
 #include <stdexcept>
-#include <iostream>
+#include <string>
+#include <vector>
 
+/*
+ * Zobrist keys, one per variable. init() derives them from a seed with
+ * splitmix64, key i from the i-th step, so the keys of a shorter length
+ * are a prefix of those of a longer one. load() reads a key file written
+ * by genZobrist instead, to reproduce runs made with it. Indexing is not
+ * checked: DSMGA2 sizes the keys to ell before any chromosome exists.
+ */
 class ZKey {
 public:
-    static constexpr size_t KEY_SIZE = 1000;
+    static const size_t KEY_SIZE = 1000;    // keys there before init()
+    static const unsigned long DEFAULT_SEED = 0x5d5a6f6272697374ul;
 
     ZKey() {
-        try {
-            const char* filename = "bin/zobristkey";
-            // std::cout << "Attempting to read Zobrist keys from: " << filename << std::endl;
-            
-            // Open file in binary mode
-            std::ifstream file(filename, std::ios::binary);
-            if (!file) {
-                throw std::runtime_error("Failed to open zobristkey file");
-            }
-
-            // Read the entire file at once
-            if (!file.read(reinterpret_cast<char*>(keys.data()), 
-                          KEY_SIZE * sizeof(unsigned long))) {
-                throw std::runtime_error("Failed to read zobristkey file");
-            }
-
-            file.close();
-            // std::cout << "Successfully read Zobrist keys" << std::endl;
-        } catch (const std::exception& e) {
-            std::cerr << "Error initializing ZKey: " << e.what() << std::endl;
-            throw; // Re-throw the exception after logging
-        }
+        init(KEY_SIZE, DEFAULT_SEED);
+    }
+
+    void init(size_t n, unsigned long seed) {
+        keys.resize(n);
+        for (size_t i = 0; i < n; ++i)
+            keys[i] = splitmix64(seed + (i + 1) * 0x9e3779b97f4a7c15ul);
+    }
+
+    // at least n keys from filename
+    void load(const char* filename, size_t n) {
+        std::ifstream file(filename, std::ios::binary | std::ios::ate);
+        if (!file)
+            throw std::runtime_error(std::string("Failed to open zobristkey file ") + filename);
+
+        size_t count = (size_t) file.tellg() / sizeof(unsigned long);
+        if (count < n)
+            throw std::runtime_error(std::string("Not enough keys in zobristkey file ") + filename);
+
+        keys.resize(count);
+        file.seekg(0);
+        if (!file.read(reinterpret_cast<char*>(keys.data()), count * sizeof(unsigned long)))
+            throw std::runtime_error(std::string("Failed to read zobristkey file ") + filename);
+    }
+
+    size_t size() const {
+        return keys.size();
     }
 
-    // Const access operator
     unsigned long operator[](size_t i) const {
-        if (i >= KEY_SIZE) {
-            throw std::out_of_range("ZKey index out of range");
-        }
         return keys[i];
     }
 
 private:
-    std::array<unsigned long, KEY_SIZE> keys;
+    static unsigned long splitmix64(unsigned long z) {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ul;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebul;
+        return z ^ (z >> 31);
+    }
+
+    std::vector<unsigned long> keys;
 };
 
 #endif // __ZKEY__
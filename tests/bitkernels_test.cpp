@@ -0,0 +1,128 @@
+// Every kernel set this CPU has gives the counts and the transpose of
+// plain bit-by-bit loops; ones it lacks are skipped.
+
+#include <cstdio>
+#include <vector>
+#include "bitkernels.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char* kernel, const char* what) {
+    if (!ok) {
+        printf("FAILED: %s: %s\n", kernel, what);
+        ++failures;
+    }
+}
+
+static unsigned long state = 88172645463325252ul;
+
+static unsigned long nextWord() {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+static int bitOf(const unsigned long* words, int k) {
+    return (words[k / 64] >> (k % 64)) & 1;
+}
+
+// pairCount over [i0, i1) x [j0, j1) of nCols random columns
+static bool pairCountAgrees(int nCols, int nWords, int i0, int i1, int j0, int j1, PairOp op) {
+    std::vector<std::vector<unsigned long> > data(nCols, std::vector<unsigned long>(nWords));
+    std::vector<const unsigned long*> cols(nCols);
+    for (int c = 0; c < nCols; ++c) {
+        for (int w = 0; w < nWords; ++w)
+            data[c][w] = nextWord();
+        cols[c] = &data[c][0];
+    }
+
+    int ldOut = j1 - j0 + 3;
+    std::vector<int> out((size_t) (i1 - i0) * ldOut, -1);
+    pairCount(&cols[0], nWords, i0, i1, j0, j1, op, &out[0], ldOut);
+
+    for (int i = i0; i < i1; ++i)
+        for (int j = j0; j < j1; ++j) {
+            int n = 0;
+            for (int w = 0; w < nWords; ++w) {
+                unsigned long x = (op == PAIR_AND) ? cols[i][w] & cols[j][w] : cols[i][w] ^ cols[j][w];
+                for (; x != 0; x &= x - 1)
+                    ++n;
+            }
+            if (out[(i - i0) * ldOut + (j - j0)] != n)
+                return false;
+        }
+    return true;
+}
+
+// transposeBits of nRows random rows of nBits
+static bool transposeAgrees(int nRows, int nBits) {
+    int rowWords = (nBits + 63) / 64;
+    int colWords = (nRows + 63) / 64;
+
+    std::vector<std::vector<unsigned long> > rowData(nRows, std::vector<unsigned long>(rowWords));
+    std::vector<const unsigned long*> rows(nRows);
+    for (int r = 0; r < nRows; ++r) {
+        for (int w = 0; w < rowWords; ++w)
+            rowData[r][w] = nextWord();
+        rows[r] = &rowData[r][0];
+    }
+
+    // stale bits everywhere, so the cleared tail is checked too
+    std::vector<std::vector<unsigned long> > colData(nBits, std::vector<unsigned long>(colWords, ~0ul));
+    std::vector<unsigned long*> cols(nBits);
+    for (int c = 0; c < nBits; ++c)
+        cols[c] = &colData[c][0];
+
+    transposeBits(&rows[0], nRows, nBits, &cols[0]);
+
+    for (int c = 0; c < nBits; ++c)
+        for (int r = 0; r < colWords * 64; ++r)
+            if (bitOf(cols[c], r) != ((r < nRows) ? bitOf(rows[r], c) : 0))
+                return false;
+    return true;
+}
+
+static bool popCountAgrees(int nWords) {
+    std::vector<unsigned long> col(nWords);
+    int n = 0;
+    for (int w = 0; w < nWords; ++w) {
+        col[w] = nextWord();
+        for (int k = 0; k < 64; ++k)
+            n += (col[w] >> k) & 1;
+    }
+    return popCount(&col[0], nWords) == n;
+}
+
+int main() {
+
+    const char* kernels[] = { "scalar", "popcnt", "avx2", "avx512vpopcntdq" };
+
+    for (const char* kernel : kernels) {
+        if (!selectBitKernel(kernel)) {
+            printf("%s: not supported here, skipped\n", kernel);
+            continue;
+        }
+
+        // partial tiles, a block boundary at 64 columns and a chunk
+        // boundary at 128 words
+        for (int op = PAIR_AND; op <= PAIR_XOR; ++op) {
+            PairOp pairOp = static_cast<PairOp>(op);
+            check(pairCountAgrees(7, 1, 0, 7, 0, 7, pairOp), kernel, "pairCount, one word");
+            check(pairCountAgrees(70, 3, 0, 70, 0, 70, pairOp), kernel, "pairCount, all pairs");
+            check(pairCountAgrees(70, 3, 5, 18, 33, 69, pairOp), kernel, "pairCount, a sub-block");
+            check(pairCountAgrees(9, 131, 0, 9, 0, 9, pairOp), kernel, "pairCount, over a chunk");
+        }
+
+        check(transposeAgrees(64, 64), kernel, "transposeBits, one block");
+        check(transposeAgrees(150, 70), kernel, "transposeBits, partial blocks");
+        check(transposeAgrees(3, 200), kernel, "transposeBits, few rows");
+
+        check(popCountAgrees(1), kernel, "popCount, one word");
+        check(popCountAgrees(37), kernel, "popCount");
+    }
+
+    if (failures == 0)
+        printf("bitkernels: all passed\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,77 @@
+// The delta function of every built-in objective gives the change a full
+// evaluation sees when the bits are flipped, for random chromosomes and
+// sets of distinct bits; lengths that end inside a word or a block too.
+
+#include <cmath>
+#include <cstdio>
+#include "chromosome.h"
+#include "fitness_functions.h"
+#include "global.h"
+
+static int failures = 0;
+
+// compares delta with full evaluations on tries random flips of ell bits
+static void check(FitnessType type, const char* name, int ell, int tries) {
+    auto fitness = getFitnessFunction(type);
+    auto delta = getDeltaFitnessFunction(type);
+    zKey.init(ell, 1);
+
+    int bits[8];
+    double worst = 0.0;
+    for (int t = 0; t < tries; ++t) {
+        Chromosome ch;
+        ch.initR(ell);
+        int n = myRand.uniformInt(0, 8);
+        myRand.uniformArray(bits, n, 0, ell - 1);
+
+        Chromosome flipped(ch);
+        for (int k = 0; k < n; ++k)
+            flipped.flip(bits[k]);
+
+        double error = fabs(delta(ch, bits, n) - (fitness(flipped) - fitness(ch)));
+        if (error > worst)
+            worst = error;
+    }
+
+    if (worst > EPSILON) {
+        printf("FAILED: %s, ell %d: delta off by %g\n", name, ell, worst);
+        ++failures;
+    }
+}
+
+int main() {
+
+    myRand.seed(1);
+
+    check(FITNESS_ONEMAX, "onemax", 100, 1000);
+    check(FITNESS_ONEMAX, "onemax", 130, 1000);
+    check(FITNESS_MKTRAP, "mktrap", 100, 1000);
+    check(FITNESS_MKTRAP, "mktrap", 130, 1000);
+    check(FITNESS_FTRAP, "ftrap", 102, 1000);
+    check(FITNESS_FTRAP, "ftrap", 132, 1000);
+    check(FITNESS_CYCTRAP, "cyctrap", 100, 1000);
+    check(FITNESS_CYCTRAP, "cyctrap", 132, 1000);
+
+    // the instances main() loads for ell = 100
+    FILE* fp = fopen("./NK_Instance/pnk100_4_5_1", "r");
+    if (fp == NULL) {
+        printf("FAILED: no NK instance; run from the source directory\n");
+        return 1;
+    }
+    loadNKWAProblem(fp, &nkwa);
+    fclose(fp);
+    check(FITNESS_NK, "nk", 100, 1000);
+    freeNKWAProblem(&nkwa);
+
+    char spin[] = "./SPIN/100/100_1";
+    loadSPIN(spin, &mySpinGlassParams);
+    check(FITNESS_SPINGLASS, "spin", 100, 1000);
+
+    char sat[] = "./SAT/uf100/uf100-01.cnf";
+    loadSAT(sat, &mySAT);
+    check(FITNESS_SAT, "sat", 100, 1000);
+
+    if (failures == 0)
+        printf("delta_eval: all passed\n");
+    return failures == 0 ? 0 : 1;
+}
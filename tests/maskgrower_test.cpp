@@ -0,0 +1,151 @@
+// MaskGrower hands out the masks of the DLLA scan it replaces, ties
+// included, from the dense graph and from float rows; from a sparse graph
+// it takes the largest connection and breaks ties by order. Edge weights
+// are multiples of 1/4, so sums are exact in float too and ties abound.
+
+#include <cstdio>
+#include <vector>
+#include "chromosome.h"
+#include "doublelinkedlistarray.h"
+#include "global.h"
+#include "linkagerows.h"
+#include "maskgrower.h"
+#include "sparsegraph.h"
+#include "trimatrix.h"
+
+static int failures = 0;
+
+static void check(bool ok, int ell, int startNode, const char* what) {
+    if (!ok) {
+        printf("FAILED: ell %d, start %d: %s\n", ell, startNode, what);
+        ++failures;
+    }
+}
+
+static double connectionOf(const TriMatrix<double>& graph, const Chromosome& ch, int i, int j) {
+    pair<double, double> p = graph(i, j);
+    return (ch.getVal(i) == ch.getVal(j)) ? p.first : p.second;
+}
+
+// the scan of the original findMask
+static vector<int> dllaMask(const TriMatrix<double>& graph, const Chromosome& ch,
+                            const int* order, int ell, int startNode) {
+    vector<int> mask(1, startNode);
+    DLLA rest(ell);
+    for (int i = 0; i < ell; ++i)
+        if (order[i] != startNode)
+            rest.insert(order[i]);
+
+    vector<double> connection(ell);
+    for (DLLA::iterator iter = rest.begin(); iter != rest.end(); iter++)
+        connection[*iter] = connectionOf(graph, ch, startNode, *iter);
+
+    while (!rest.isEmpty()) {
+        double max = -INF;
+        int index = -1;
+        for (DLLA::iterator iter = rest.begin(); iter != rest.end(); iter++)
+            if (max < connection[*iter]) {
+                max = connection[*iter];
+                index = *iter;
+            }
+        rest.erase(index);
+        mask.push_back(index);
+        for (DLLA::iterator iter = rest.begin(); iter != rest.end(); iter++)
+            connection[*iter] += connectionOf(graph, ch, index, *iter);
+    }
+    return mask;
+}
+
+// largest connection over the edges kept, missing ones counting 0;
+// ties go to the earlier variable in order
+static vector<int> sparseMask(const TriMatrix<double>& graph, const vector<vector<char> >& kept,
+                              const Chromosome& ch, const int* order, int ell, int startNode) {
+    vector<int> mask(1, startNode);
+    vector<char> taken(ell, 0);
+    vector<double> connection(ell, 0.0);
+    taken[startNode] = 1;
+    int last = startNode;
+    for (int step = 1; step < ell; ++step) {
+        for (int j = 0; j < ell; ++j)
+            if (!taken[j] && kept[last][j])
+                connection[j] += connectionOf(graph, ch, last, j);
+        int best = -1;
+        for (int t = 0; t < ell; ++t) {
+            int j = order[t];
+            if (!taken[j] && (best == -1 || connection[j] > connection[best]))
+                best = j;
+        }
+        taken[best] = 1;
+        mask.push_back(best);
+        last = best;
+    }
+    return mask;
+}
+
+static vector<int> grow(MaskGrower& grower) {
+    vector<int> mask;
+    for (int j = grower.next(); j != -1; j = grower.next())
+        mask.push_back(j);
+    return mask;
+}
+
+// every start node of one random graph, chromosome and order
+static void checkGraph(int ell, double density) {
+
+    zKey.init(ell, 1);
+    Chromosome ch;
+    ch.initR(ell);
+
+    vector<int> order(ell);
+    myRand.uniformArray(&order[0], ell, 0, ell - 1);
+
+    TriMatrix<double> dense(ell);
+    LinkageRows rows;
+    rows.init(ell);
+    vector<vector<char> > kept(ell, vector<char>(ell, 0));
+    vector<vector<SparseGraph<double>::Edge> > candidates(ell);
+    for (int i = 0; i < ell; ++i)
+        for (int j = 0; j < i; ++j) {
+            pair<double, double> p(myRand.uniformInt(0, 2) / 4.0, myRand.uniformInt(0, 2) / 4.0);
+            dense.write(i, j, p);
+            rows.write(i, j, p);
+            if (myRand.uniform() < density) {
+                kept[i][j] = kept[j][i] = 1;
+                candidates[i].push_back(SparseGraph<double>::Edge(j, p));
+            }
+        }
+    SparseGraph<double> sparse;
+    sparse.build(candidates);
+
+    MaskGrower grower;
+    for (int startNode = 0; startNode < ell; ++startNode) {
+        vector<int> expected = dllaMask(dense, ch, &order[0], ell, startNode);
+
+        grower.start(dense, ch, &order[0], ell, startNode);
+        check(grow(grower) == expected, ell, startNode, "dense mask differs from the DLLA scan");
+        bool denseTied = grower.tied();
+
+        grower.start(rows, ch, &order[0], ell, startNode);
+        check(grow(grower) == expected, ell, startNode, "float-row mask differs from the DLLA scan");
+        check(grower.tied() == denseTied, ell, startNode, "float rows and dense graph disagree on ties");
+
+        grower.start(sparse, ch, &order[0], ell, startNode);
+        check(grow(grower) == sparseMask(dense, kept, ch, &order[0], ell, startNode), ell, startNode,
+              "sparse mask differs from largest connection, ties by order");
+    }
+}
+
+int main() {
+
+    myRand.seed(1);
+
+    // one word of genes and of float rows, then rows over a word
+    checkGraph(40, 1.0);
+    checkGraph(40, 0.2);
+    checkGraph(70, 1.0);
+    checkGraph(70, 0.1);
+
+    if (failures == 0)
+        printf("maskgrower: all passed\n");
+    return failures == 0 ? 0 : 1;
+}
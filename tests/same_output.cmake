@@ -0,0 +1,24 @@
+# Runs DSMGA2 ARGS once with SWITCH=1 and once with SWITCH=0 in the
+# environment and fails unless the two outputs are identical and, if
+# EXPECT is given, match that regular expression.
+#   cmake -DDSMGA2=<exe> "-DARGS=<arguments>" -DSWITCH=<variable> [-DEXPECT=<regex>] -P same_output.cmake
+
+separate_arguments(ARGS)
+
+foreach(value 1 0)
+    set(ENV{${SWITCH}} ${value})
+    execute_process(COMMAND ${DSMGA2} ${ARGS}
+        OUTPUT_VARIABLE output_${value}
+        RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "DSMGA2 ${ARGS} failed with ${SWITCH}=${value}: ${result}")
+    endif()
+endforeach()
+
+if(NOT output_1 STREQUAL output_0)
+    message(FATAL_ERROR "DSMGA2 ${ARGS} differs between ${SWITCH}=1 and ${SWITCH}=0:\n${output_1}\n--\n${output_0}")
+endif()
+
+if(DEFINED EXPECT AND NOT output_0 MATCHES "${EXPECT}")
+    message(FATAL_ERROR "DSMGA2 ${ARGS} output does not match ${EXPECT}:\n${output_0}")
+endif()
@@ -0,0 +1,64 @@
+// ThreadPool::run rethrows a task's exception once every worker is done
+// with the job, and the pool takes the next job as usual.
+
+#include <atomic>
+#include <cstdio>
+#include <stdexcept>
+
+#include "threadpool.h"
+
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+    if (!ok) {
+        printf("FAILED: %s\n", what);
+        ++failures;
+    }
+}
+
+// runs fn on the pool and returns whether run() threw a runtime_error
+template<class Fn>
+static bool throws(ThreadPool& pool, int nTasks, Fn fn) {
+    try {
+        pool.run(nTasks, fn);
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+int main() {
+
+    ThreadPool pool(4);
+
+    // one task throws; the others keep to the job they were given
+    std::atomic<int> done(0);
+    check(throws(pool, 1000, [&](int t, int) {
+        if (t == 37)
+            throw std::runtime_error("task 37");
+        ++done;
+    }), "an exception of one task reaches run()");
+    check(done < 1000, "the task that threw is not counted as done");
+
+    // every task throws, so worker 0 does too
+    check(throws(pool, 64, [](int, int) {
+        throw std::runtime_error("every task");
+    }), "an exception of worker 0 reaches run()");
+
+    // and the pool still runs every task of the next job
+    std::atomic<long> sum(0);
+    pool.run(1000, [&](int t, int) { sum += t; });
+    check(sum == 999L * 1000 / 2, "the next job runs in full");
+
+    // a pool of one runs the tasks itself
+    ThreadPool single(1);
+    check(throws(single, 10, [](int t, int) {
+        if (t == 3)
+            throw std::runtime_error("task 3");
+    }), "an exception reaches run() without threads");
+
+    if (failures == 0)
+        printf("threadpool: all passed\n");
+    return failures == 0 ? 0 : 1;
+}